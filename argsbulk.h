@@ -0,0 +1,300 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include "argsparser.h"
+#include <exception>
+#include <iterator>
+#include <map>
+#include <thread>
+
+namespace args {
+	namespace detail {
+		inline bool is_blank(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+		}
+
+		// Splits a command line like a POSIX shell without expansions:
+		// '...' is literal, "..." honours \" \\ \$ and \`, and outside of
+		// quotes a backslash escapes the next character. Words are stored
+		// NUL-terminated in storage, argv points into it.
+		inline void tokenize(std::string_view line, std::pmr::string& storage, std::pmr::vector<char*>& argv)
+		{
+			storage.clear();
+			argv.clear();
+			// no word is longer than its source, each adds one NUL
+			storage.reserve(line.length() * 2 + 1);
+
+			size_t i = 0;
+			auto length = line.length();
+			while (true) {
+				while (i < length && is_blank(line[i]))
+					++i;
+				if (i >= length)
+					break;
+
+				auto start = storage.length();
+				while (i < length && !is_blank(line[i])) {
+					auto c = line[i++];
+					if (c == '\'') {
+						while (i < length && line[i] != '\'')
+							storage.push_back(line[i++]);
+						if (i < length)
+							++i;
+					} else if (c == '"') {
+						while (i < length && line[i] != '"') {
+							if (line[i] == '\\' && i + 1 < length) {
+								switch (line[i + 1]) {
+								case '"': case '\\': case '$': case '`':
+									++i;
+								}
+							}
+							storage.push_back(line[i++]);
+						}
+						if (i < length)
+							++i;
+					} else if (c == '\\' && i < length)
+						storage.push_back(line[i++]);
+					else
+						storage.push_back(c);
+				}
+				storage.push_back('\0');
+				argv.push_back(storage.data() + start);
+			}
+		}
+	}
+
+	// Parses many recorded command lines against one shared schema, on
+	// several threads. Actions never run: every row is parsed in capture
+	// mode, with an empty environment and without exiting, and the raw
+	// values land in one column per action. Rows that do not parse have
+	// no values, only their status, message and command.
+	//
+	// table::command holds the path of the selected command, e.g.
+	// "remote add" for nested commands. The actions of each command
+	// selected by any row have columns of their own, under that path in
+	// table::command_columns; they have a row for every line, too.
+	class bulk {
+	public:
+		class column {
+			friend class bulk;
+
+			std::vector<size_t> rows_ { 0 };
+			std::vector<size_t> ends_;
+			std::string text_;
+
+			// A row that failed keeps none of the values read before the
+			// error, so no column holds a partial row.
+			void end_row(bool keep)
+			{
+				if (!keep) {
+					auto start = rows_.back();
+					ends_.resize(start);
+					text_.resize(start ? ends_[start - 1] : 0);
+				}
+				rows_.push_back(ends_.size());
+			}
+
+			void skip(size_t rows)
+			{
+				rows_.insert(rows_.end(), rows, ends_.size());
+			}
+
+			void append(const column& other)
+			{
+				auto values = ends_.size();
+				auto text = text_.length();
+				for (auto it = other.rows_.begin() + 1; it != other.rows_.end(); ++it)
+					rows_.push_back(*it + values);
+				for (auto end : other.ends_)
+					ends_.push_back(end + text);
+				text_.append(other.text_);
+			}
+		public:
+			// Number of times the argument was given in the row.
+			size_t count(size_t row) const { return rows_[row + 1] - rows_[row]; }
+			bool present(size_t row) const { return count(row) != 0; }
+
+			std::string_view value(size_t row, size_t index = 0) const
+			{
+				assert(index < count(row));
+				auto item = rows_[row] + index;
+				auto begin = item ? ends_[item - 1] : 0;
+				return { text_.data() + begin, ends_[item] - begin };
+			}
+		};
+
+		struct table {
+			size_t rows = 0;
+			std::vector<column> columns; // indexed by builder::id()
+			// by command path, then by builder::id() in the command's factory
+			std::map<std::string, std::vector<column>, std::less<>> command_columns;
+			std::vector<std::string> command;
+			std::vector<result::status> status;
+			std::vector<std::string> message;
+		};
+	private:
+		std::shared_ptr<const schema> schema_;
+		size_t threads_;
+
+		class row_sink : public capture_sink {
+			table& out_;
+			std::vector<column>* columns_;
+			size_t row_ = 0;
+		public:
+			explicit row_sink(table& out) : out_ { out }, columns_ { &out.columns } {}
+
+			void value(size_t id, std::string_view value) override
+			{
+				auto& col = (*columns_)[id];
+				col.text_.append(value);
+				col.ends_.push_back(col.text_.length());
+			}
+
+			// Columns of a command seen for the first time start with an
+			// empty row for each row before this one
+			void command(std::string_view name, const schema& def) override
+			{
+				auto& path = out_.command.back();
+				if (columns_ != &out_.columns)
+					path.append(" ");
+				path.append(name);
+
+				auto& columns = out_.command_columns[path];
+				if (columns.empty()) {
+					columns.resize(def.size());
+					for (auto& col : columns)
+						col.skip(row_);
+				}
+				columns_ = &columns;
+			}
+
+			void end_row(bool keep)
+			{
+				for (auto& col : out_.columns)
+					col.end_row(keep);
+				for (auto& item : out_.command_columns) {
+					for (auto& col : item.second)
+						col.end_row(keep);
+				}
+				columns_ = &out_.columns;
+				++row_;
+			}
+		};
+
+		void run(const std::string_view* lines, size_t count, table& out) const
+		{
+			static const char* const no_env[] = { nullptr };
+
+			std::pmr::unsynchronized_pool_resource pool;
+			parser p { schema_, { }, &pool };
+			row_sink sink { out };
+			p.environment(no_env);
+			p.capture(&sink);
+
+			out.rows = count;
+			out.columns.resize(schema_->size());
+			out.command.reserve(count);
+			out.status.reserve(count);
+			out.message.reserve(count);
+
+			std::pmr::string storage { &pool };
+			std::pmr::vector<char*> argv { &pool };
+			for (size_t row = 0; row < count; ++row) {
+				detail::tokenize(lines[row], storage, argv);
+				out.command.emplace_back();
+				auto res = p.try_parse(static_cast<int>(argv.size()), argv.data());
+				sink.end_row(res.code == result::ok);
+				out.status.push_back(res.code);
+				out.message.emplace_back(res.message);
+			}
+		}
+	public:
+		explicit bulk(std::shared_ptr<const schema> shared, size_t threads = std::thread::hardware_concurrency())
+			: schema_ { std::move(shared) }, threads_ { threads ? threads : 1 }
+		{
+			assert(schema_->compiled() && "args::schema must come from parser::share()");
+		}
+
+		table parse(const std::vector<std::string_view>& lines) const
+		{
+			constexpr size_t min_rows = 1024;
+			auto workers = (lines.size() + min_rows - 1) / min_rows;
+			if (workers > threads_) workers = threads_;
+			if (!workers) workers = 1;
+
+			auto chunk = (lines.size() + workers - 1) / workers;
+			std::vector<table> parts(workers);
+			std::vector<std::exception_ptr> errors(workers);
+			auto work = [&](size_t part) {
+				auto from = std::min(part * chunk, lines.size());
+				auto to = std::min(from + chunk, lines.size());
+				try {
+					run(lines.data() + from, to - from, parts[part]);
+				} catch (...) {
+					errors[part] = std::current_exception();
+				}
+			};
+
+			std::vector<std::thread> pool;
+			pool.reserve(workers - 1);
+			for (size_t part = 1; part < workers; ++part)
+				pool.emplace_back(work, part);
+			work(0);
+			for (auto& thread : pool)
+				thread.join();
+
+			for (auto& error : errors) {
+				if (error)
+					std::rethrow_exception(error);
+			}
+
+			auto out = std::move(parts[0]);
+			for (size_t part = 1; part < workers; ++part) {
+				auto& next = parts[part];
+				auto rows = out.rows;
+				out.rows += next.rows;
+				for (size_t id = 0; id < out.columns.size(); ++id)
+					out.columns[id].append(next.columns[id]);
+
+				// a command missing from either part has empty rows there
+				for (auto& item : out.command_columns) {
+					if (next.command_columns.find(item.first) == next.command_columns.end()) {
+						for (auto& col : item.second)
+							col.skip(next.rows);
+					}
+				}
+				for (auto& item : next.command_columns) {
+					auto& columns = out.command_columns[item.first];
+					if (columns.empty()) {
+						columns.resize(item.second.size());
+						for (auto& col : columns)
+							col.skip(rows);
+					}
+					for (size_t id = 0; id < columns.size(); ++id)
+						columns[id].append(item.second[id]);
+				}
+				std::move(next.command.begin(), next.command.end(), std::back_inserter(out.command));
+				out.status.insert(out.status.end(), next.status.begin(), next.status.end());
+				std::move(next.message.begin(), next.message.end(), std::back_inserter(out.message));
+			}
+			return out;
+		}
+
+		// One row per line; a final newline does not start another row.
+		table parse(std::string_view log) const
+		{
+			std::vector<std::string_view> lines;
+			while (!log.empty()) {
+				auto end = log.find('\n');
+				if (end == std::string_view::npos)
+					end = log.length();
+				lines.push_back(log.substr(0, end));
+				log.remove_prefix(end < log.length() ? end + 1 : end);
+			}
+			return parse(lines);
+		}
+	};
+}
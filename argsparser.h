@@ -7,10 +7,34 @@
 #define ARGS_TRANSLATOR args::null_translator
 #endif
 
+// Bytes available in place for a parser::custom callable
+#ifndef ARGS_CUSTOM_CAPACITY
+#define ARGS_CUSTOM_CAPACITY (6 * sizeof(void*))
+#endif
+
+#include <algorithm>
+#include <array>
+#ifdef ARGS_INSTRUMENT
+#	include <chrono>
+#endif
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
+#include <clocale>
 #include <cstdlib>
+#include <cstring>
 
 #ifdef _WIN32
 #	include <io.h>
@@ -18,10 +42,16 @@
 #else
 #	include <sys/ioctl.h>
 #	include <unistd.h>
+extern "C" char** environ;
 #	define _isatty(FD) isatty(FD)
 #	define _fileno(OBJ) fileno(OBJ)
 #endif
 
+#if !defined(ARGS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#	include <emmintrin.h>
+#	define ARGS_SSE2
+#endif
+
 #if defined(__has_include)
 #	if __has_include(<libintl.h>)
 #		include <libintl.h>
@@ -29,16 +59,11 @@
 #	endif
 #endif
 
-#if defined(__has_include) && defined(HAS_GETTEXT)
-#	if __has_include("fmtstr.h")
-#		include "fmtstr.h"
-#	endif
-#endif
-
 #include "callable.h"
 
 namespace args {
 	class parser;
+	class schema;
 
 	enum lng {
 		usage,
@@ -48,13 +73,198 @@ namespace args {
 		help_description,
 		unrecognized,
 		needs_param,
-		requires,
-		error_msg
+		required_arg,
+		error_msg,
+		commands,
+		command_meta,
+		not_allowed_with,
+		one_of_required,
+		depends_on,
+		invalid_choice,
+		env_note,
+		invalid_value,
+#if (defined(_MSVC_LANG) ? _MSVC_LANG : __cplusplus) < 202002L
+		// pre-C++20 spelling, requires is a keyword since then
+		requires = required_arg,
+#endif
+	};
+
+	namespace detail {
+		constexpr size_t lng_count = lng::invalid_value + 1;
+
+		inline const char* message_locale()
+		{
+#ifdef LC_MESSAGES
+			auto name = std::setlocale(LC_MESSAGES, nullptr);
+#else
+			auto name = std::setlocale(LC_ALL, nullptr);
+#endif
+			return name ? name : "";
+		}
+
+		// All messages of one locale, split once into literal runs and $N
+		// references; rendering a message is a table lookup and a concatenation.
+		class catalog {
+			struct piece {
+				size_t offset;
+				size_t length;
+				size_t arg; // 0 for literal text
+			};
+
+			std::pmr::string locale_;
+			std::pmr::string text_;
+			std::pmr::vector<piece> pieces_;
+			std::array<std::pair<size_t, size_t>, lng_count> index_ { };
+
+			void literal(const char* from, const char* to)
+			{
+				if (from == to)
+					return;
+				pieces_.push_back({ text_.length(), size_t(to - from), 0 });
+				text_.append(from, to);
+			}
+
+			void compile(size_t id, const char* msg)
+			{
+				auto cur = msg ? msg : "";
+				auto end = cur + std::strlen(cur);
+				auto start = cur;
+
+				index_[id].first = pieces_.size();
+				while (cur != end) {
+					if (*cur != '$') {
+						++cur;
+						continue;
+					}
+
+					literal(start, cur);
+					++cur;
+					if (cur != end && *cur == '$') {
+						start = cur++;
+						continue;
+					}
+
+					size_t ndx = 0;
+					while (cur != end && *cur >= '0' && *cur <= '9')
+						ndx = ndx * 10 + (*cur++ - '0');
+					if (ndx)
+						pieces_.push_back({ 0, 0, ndx });
+					start = cur;
+				}
+				literal(start, end);
+				index_[id].second = pieces_.size() - index_[id].first;
+			}
+		public:
+			catalog(std::pmr::memory_resource* mr, std::string_view locale) : locale_ { locale, mr }, text_ { mr }, pieces_(mr)
+			{
+			}
+
+			const std::pmr::string& locale() const { return locale_; }
+
+			void load(stdex::function_ref<const char*(lng)> loader)
+			{
+				for (size_t id = 0; id < lng_count; ++id)
+					compile(id, loader(static_cast<lng>(id)));
+			}
+
+			std::pmr::string render(std::pmr::memory_resource* mr, lng id, std::initializer_list<std::string_view> args) const
+			{
+				std::pmr::string out { mr };
+				if (size_t(id) >= lng_count)
+					return out;
+
+				auto from = pieces_.data() + index_[id].first;
+				auto to = from + index_[id].second;
+				auto value = [&](const piece& item) -> std::string_view {
+					if (!item.arg)
+						return { text_.data() + item.offset, item.length };
+					return item.arg <= args.size() ? args.begin()[item.arg - 1] : std::string_view { };
+				};
+
+				size_t length = 0;
+				for (auto it = from; it != to; ++it)
+					length += value(*it).length();
+
+				out.reserve(length);
+				for (auto it = from; it != to; ++it)
+					out.append(value(*it));
+				return out;
+			}
+		};
+	}
+
+	// Final provides load(lng) returning a pattern with $1, $2 placeholders
+	// ($$ for a dollar sign). Patterns are compiled once and recompiled when
+	// LC_MESSAGES changes, unless Final declares itself not localized.
+	template <typename Final>
+	class translator_base {
+		std::pmr::memory_resource* mr_ = std::pmr::get_default_resource();
+		std::optional<detail::catalog> catalog_;
+		size_t generation_ = 0;
+
+		const detail::catalog& catalog()
+		{
+			std::string_view locale;
+			if constexpr (Final::localized) {
+				locale = detail::message_locale();
+				if (catalog_ && catalog_->locale() != locale)
+					catalog_.reset();
+			}
+
+			if (!catalog_) {
+				++generation_;
+				auto& loader = *static_cast<Final*>(this);
+				catalog_.emplace(mr_, locale);
+				catalog_->load([&](lng id) { return loader.load(id); });
+			}
+			return *catalog_;
+		}
+	public:
+		static constexpr bool localized = true;
+
+		translator_base() = default;
+		// A copy shares the resource and compiles its own catalog on first
+		// use; copying the catalog would allocate from the default resource.
+		translator_base(const translator_base& other) : mr_ { other.mr_ } {}
+		translator_base(translator_base&&) = default;
+		translator_base& operator=(const translator_base& other)
+		{
+			mr_ = other.mr_;
+			catalog_.reset();
+			return *this;
+		}
+		translator_base& operator=(translator_base&&) = default;
+
+		void resource(std::pmr::memory_resource* mr)
+		{
+			mr_ = mr;
+			catalog_.reset();
+		}
+		std::pmr::memory_resource* resource() const { return mr_; }
+
+		// Needed after changes the locale check cannot see, e.g. a new
+		// gettext text domain.
+		void invalidate() { catalog_.reset(); }
+
+		// Changes every time the patterns are recompiled
+		size_t generation()
+		{
+			catalog();
+			return generation_;
+		}
+
+		template <typename... Args>
+		std::pmr::string operator()(lng id, Args&&... args)
+		{
+			return catalog().render(mr_, id, { std::string_view { args }... });
+		}
 	};
 
-	class null_translator {
+	class null_translator : public translator_base<null_translator> {
 	public:
-		std::string operator()(lng id, const std::string& arg1 = { }, const std::string& arg2 = { })
+		static constexpr bool localized = false;
+
+		const char* load(lng id)
 		{
 			switch (id) {
 			case lng::usage:            return "usage: ";
@@ -62,28 +272,23 @@ namespace args {
 			case lng::positionals: 	    return "positional arguments";
 			case lng::optionals:	    return "optional arguments";
 			case lng::help_description: return "show this help message and exit";
-			case lng::unrecognized:	    return "unrecognized argument: " + arg1;
-			case lng::needs_param:	    return "argument " + arg1 + ": expected one argument";
-			case lng::requires:		    return "argument " + arg1 + " is required";
-			case lng::error_msg:	    return arg1 + ": error: " + arg2;
+			case lng::unrecognized:	    return "unrecognized argument: $1";
+			case lng::needs_param:	    return "argument $1: expected one argument";
+			case lng::required_arg:     return "argument $1 is required";
+			case lng::error_msg:	    return "$1: error: $2";
+			case lng::commands:	        return "commands";
+			case lng::command_meta:	    return "COMMAND";
+			case lng::not_allowed_with: return "argument $1: not allowed with argument $2";
+			case lng::one_of_required:  return "one of the arguments $1 is required";
+			case lng::depends_on:       return "argument $1 requires argument $2";
+			case lng::invalid_choice:   return "argument $1: invalid choice: '$2' (choose from $3)";
+			case lng::env_note:         return "[env: $1]";
+			case lng::invalid_value:    return "argument $1: invalid value: '$2'";
 			}
 			return "<unrecognized string>";
 		}
 	};
 
-#ifdef HAS_FMTSTR
-	template <typename Final>
-	class translator_base {
-	public:
-		template <typename... Args>
-		std::string operator()(lng id, Args&&... args)
-		{
-			auto& loader = *static_cast<Final*>(this);
-			return fmt::str(loader.load(id), std::forward<Args>(args)...);
-		}
-	};
-#endif
-
 #ifdef HAS_GETTEXT
 	class gettext_translator : public translator_base<gettext_translator> {
 	public:
@@ -97,8 +302,16 @@ namespace args {
 			case lng::help_description: return gettext("show this help message and exit");
 			case lng::unrecognized:	    return gettext("unrecognized argument: $1");
 			case lng::needs_param:	    return gettext("argument $1: expected one argument");
-			case lng::requires:		    return gettext("argument $1 is required");
+			case lng::required_arg:     return gettext("argument $1 is required");
 			case lng::error_msg:	    return gettext("$1: error: $2");
+			case lng::commands:	        return gettext("commands");
+			case lng::command_meta:	    return gettext("COMMAND");
+			case lng::not_allowed_with: return gettext("argument $1: not allowed with argument $2");
+			case lng::one_of_required:  return gettext("one of the arguments $1 is required");
+			case lng::depends_on:       return gettext("argument $1 requires argument $2");
+			case lng::invalid_choice:   return gettext("argument $1: invalid choice: '$2' (choose from $3)");
+			case lng::env_note:         return gettext("[env: $1]");
+			case lng::invalid_value:    return gettext("argument $1: invalid value: '$2'");
 			}
 			return "<unrecognized string>";
 		}
@@ -107,7 +320,282 @@ namespace args {
 
 	using translator = ARGS_TRANSLATOR;
 
+	// Stored in place; parser::command() allocates larger factories from
+	// the schema's memory resource
+	using command_factory = stdex::inplace_function<void(parser&), ARGS_CUSTOM_CAPACITY>;
+
+	enum shell {
+		bash,
+		zsh,
+		fish
+	};
+
+	struct result {
+		enum status {
+			ok,
+			help,
+			error,
+			complete
+		};
+
+		status code = ok;
+		std::pmr::string message;
+
+		explicit operator bool() const { return code == ok; }
+	};
+
+#ifdef ARGS_INSTRUMENT
+	// Collected only when ARGS_INSTRUMENT is defined. Registration time adds
+	// up over the parser's lifetime, everything else covers the last
+	// bind() and parse(). Phases do not overlap; a command's parse is part
+	// of its parent's dispatch.
+	struct stats {
+		enum phase {
+			registration,
+			tokenizing,
+			dispatch,
+			required,
+			rendering
+		};
+		static constexpr size_t phases = rendering + 1;
+
+		std::array<std::chrono::nanoseconds, phases> time { };
+		size_t lookups = 0;
+		size_t comparisons = 0;
+		size_t visits = 0;
+		size_t allocations = 0;
+		size_t allocated = 0;
+	};
+
+	using stats_callback = std::function<void(const stats&)>;
+#endif
+
+	// Receives the raw arguments of a parser in capture mode, in command
+	// line order. Flags arrive with an empty value. After command(), values
+	// come from the command's parser and use the ids of its schema.
+	struct capture_sink {
+		virtual ~capture_sink() {}
+		virtual void value(size_t id, std::string_view value) = 0;
+		virtual void command(std::string_view name, const schema& def) = 0;
+	};
+
+	// Text that outlives every schema it is handed to, e.g. a literal or a
+	// table with static storage. The schema keeps it by reference.
+	class static_text {
+		std::string_view view_;
+	public:
+		explicit constexpr static_text(std::string_view text) noexcept : view_ { text } {}
+
+		constexpr std::string_view view() const noexcept { return view_; }
+	};
+
+	// Text handed to the schema: names, help, meta and env. Only
+	// static_text is kept by reference; everything else is copied.
+	class str_ref {
+		std::string_view view_;
+		bool borrowed_ = false;
+	public:
+		constexpr str_ref(static_text text) noexcept : view_ { text.view() }, borrowed_ { true } {}
+		constexpr str_ref(std::string_view text) noexcept : view_ { text } {}
+		template <typename Alloc>
+		str_ref(const std::basic_string<char, std::char_traits<char>, Alloc>& text) noexcept : view_ { text } {}
+		str_ref(const char* text) noexcept : view_ { text ? text : "" } {}
+
+		constexpr std::string_view view() const noexcept { return view_; }
+		constexpr bool borrowed() const noexcept { return borrowed_; }
+	};
+
+	namespace detail {
+		struct pmr_delete {
+			std::pmr::memory_resource* mr;
+			size_t size;
+			size_t align;
+
+			template <typename T>
+			void operator()(T* ptr) const
+			{
+				ptr->~T();
+				mr->deallocate(ptr, size, align);
+			}
+		};
+
+		template <typename T>
+		using pmr_ptr = std::unique_ptr<T, pmr_delete>;
+
+		template <typename T, typename... Args>
+		inline pmr_ptr<T> pmr_make(std::pmr::memory_resource* mr, Args&&... args)
+		{
+			auto mem = mr->allocate(sizeof(T), alignof(T));
+			try {
+				return { new (mem) T(std::forward<Args>(args)...), { mr, sizeof(T), alignof(T) } };
+			} catch (...) {
+				mr->deallocate(mem, sizeof(T), alignof(T));
+				throw;
+			}
+		}
+
+		// Bump allocator for what lives as long as a schema; deallocate is a
+		// no-op and the chunks go back upstream in the destructor. Unlike
+		// std::pmr::monotonic_buffer_resource, it is entirely inline: at -O2
+		// GCC 12 devirtualizes calls on a monotonic_buffer_resource member
+		// into monotonic_buffer_resource::do_allocate, which its libstdc++
+		// does not export, and the program fails to link.
+		class arena_resource : public std::pmr::memory_resource {
+			struct chunk {
+				chunk* next;
+				size_t size;
+			};
+
+			std::pmr::memory_resource* upstream_;
+			chunk* chunks_ = nullptr;
+			char* current_ = nullptr;
+			size_t avail_ = 0;
+			size_t next_size_ = 1024;
+		public:
+			explicit arena_resource(std::pmr::memory_resource* upstream) : upstream_ { upstream } {}
+			arena_resource(const arena_resource&) = delete;
+			arena_resource& operator=(const arena_resource&) = delete;
+
+			~arena_resource()
+			{
+				while (chunks_) {
+					auto next = chunks_->next;
+					upstream_->deallocate(chunks_, chunks_->size, alignof(std::max_align_t));
+					chunks_ = next;
+				}
+			}
+		private:
+			void* do_allocate(size_t bytes, size_t align) override
+			{
+				if (!bytes)
+					bytes = 1; // never the same pointer twice
+				void* ptr = current_;
+				if (!std::align(align, bytes, ptr, avail_)) {
+					auto size = next_size_;
+					while (size < sizeof(chunk) + bytes + align)
+						size *= 2;
+					if (next_size_ < 64 * 1024)
+						next_size_ *= 2;
+
+					chunks_ = new (upstream_->allocate(size, alignof(std::max_align_t))) chunk { chunks_, size };
+					ptr = chunks_ + 1;
+					avail_ = size - sizeof(chunk);
+					std::align(align, bytes, ptr, avail_);
+				}
+				current_ = static_cast<char*>(ptr) + bytes;
+				avail_ -= bytes;
+				return ptr;
+			}
+
+			void do_deallocate(void*, size_t, size_t) override {}
+
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+			{
+				return this == &other;
+			}
+		};
+
+		// Text of a schema outlives its actions; copies go to the schema's
+		// arena, static_text is kept as given
+		inline std::string_view keep(std::pmr::memory_resource* arena, str_ref text)
+		{
+			auto view = text.view();
+			if (text.borrowed() || view.empty())
+				return view;
+			auto data = static_cast<char*>(arena->allocate(view.length(), 1));
+			std::memcpy(data, view.data(), view.length());
+			return { data, view.length() };
+		}
+
+		class name_list {
+			const std::string_view* names_ = nullptr;
+			size_t size_ = 0;
+		public:
+			name_list() = default;
+			name_list(const std::string_view* names, size_t size) : names_ { names }, size_ { size } {}
+
+			const std::string_view* begin() const { return names_; }
+			const std::string_view* end() const { return names_ + size_; }
+			size_t size() const { return size_; }
+			bool empty() const { return !size_; }
+			const std::string_view& front() const { return names_[0]; }
+			const std::string_view& operator[](size_t index) const { return names_[index]; }
+		};
+	}
+
 	namespace actions {
+		// Stored like command_factory; candidates go to out, which uses the
+		// parser's memory resource
+		using completer = stdex::inplace_function<void(std::string_view /*prefix*/, std::pmr::vector<std::pmr::string>& /*out*/), ARGS_CUSTOM_CAPACITY>;
+
+		// Valid values of an argument. The open addressing table is built by
+		// schema::compile, after which find() hashes the value once and
+		// usually compares a single candidate.
+		class choice_set {
+			std::pmr::vector<std::pmr::string> names_;
+			std::pmr::vector<uint32_t> slots_; // index + 1, 0 for empty
+			size_t mask_ = 0;
+
+			static size_t hash(std::string_view name)
+			{
+				uint64_t value = 14695981039346656037ull;
+				for (auto c : name) {
+					value ^= static_cast<unsigned char>(c);
+					value *= 1099511628211ull;
+				}
+				return static_cast<size_t>(value ^ (value >> 32));
+			}
+		public:
+			static constexpr size_t npos = size_t(-1);
+
+			explicit choice_set(std::pmr::memory_resource* mr) : names_ { mr }, slots_(mr) {}
+
+			void assign(std::initializer_list<std::string_view> names)
+			{
+				names_.clear();
+				names_.reserve(names.size());
+				for (auto name : names)
+					names_.emplace_back(name);
+				slots_.clear();
+			}
+
+			void build()
+			{
+				size_t size = 8;
+				while (size < names_.size() * 2)
+					size *= 2;
+				mask_ = size - 1;
+				slots_.assign(size, 0);
+
+				for (size_t index = 0; index < names_.size(); ++index) {
+					if (find(names_[index]) != npos)
+						continue;
+					auto slot = hash(names_[index]) & mask_;
+					while (slots_[slot])
+						slot = (slot + 1) & mask_;
+					slots_[slot] = static_cast<uint32_t>(index + 1);
+				}
+			}
+
+			size_t find(std::string_view name) const
+			{
+				assert(!slots_.empty() && "args::choice_set used before schema::compile");
+				if (slots_.empty()) {
+					auto it = std::find(names_.begin(), names_.end(), name);
+					return it == names_.end() ? npos : size_t(it - names_.begin());
+				}
+				for (auto slot = hash(name) & mask_; slots_[slot]; slot = (slot + 1) & mask_) {
+					auto index = slots_[slot] - 1;
+					if (names_[index] == name)
+						return index;
+				}
+				return npos;
+			}
+
+			bool empty() const { return names_.empty(); }
+			const std::pmr::vector<std::pmr::string>& names() const { return names_; }
+		};
+
 		struct action {
 			virtual ~action() {}
 			virtual bool required() const = 0;
@@ -115,21 +603,31 @@ namespace args {
 			virtual bool multiple() const = 0;
 			virtual void multiple(bool value) = 0;
 			virtual bool needs_arg() const = 0;
-			virtual void visit(parser&) = 0;
-			virtual void visit(parser&, const std::string& /*arg*/) = 0;
-			virtual bool visited() const = 0;
-			virtual void meta(const std::string& s) = 0;
-			virtual const std::string& meta() const = 0;
-			virtual std::string meta_name(translator&) const = 0;
-			virtual void help(const std::string& s) = 0;
-			virtual const std::string& help() const = 0;
-			virtual bool is(const std::string& name) const = 0;
+			virtual void visit(parser&, void* /*dst*/) = 0;
+			// false when arg is not a valid value for the destination
+			virtual bool visit(parser&, void* /*dst*/, std::string_view /*arg*/) = 0;
+			virtual bool visit(parser&, void* /*dst*/, std::string_view /*arg*/, size_t /*choice*/) = 0;
+			// What visit() would return, without storing anything
+			virtual bool accepts(std::string_view /*arg*/) const = 0;
+			virtual void choices(std::initializer_list<std::string_view> names) = 0;
+			virtual const choice_set& choices() const = 0;
+			virtual void compile() = 0;
+			virtual void meta(str_ref s) = 0;
+			virtual std::string_view meta() const = 0;
+			virtual std::pmr::string meta_name(translator&) const = 0;
+			virtual void help(str_ref s) = 0;
+			virtual std::string_view help() const = 0;
+			virtual void env(str_ref name) = 0;
+			virtual std::string_view env() const = 0;
+			virtual void complete(completer cb) = 0;
+			virtual const completer& complete() const = 0;
+			virtual bool is(std::string_view name) const = 0;
 			virtual bool is(char name) const = 0;
-			virtual const std::vector<std::string>& names() const = 0;
+			virtual detail::name_list names() const = 0;
 
-			void append_short_help(translator& _, std::string& s) const
+			void append_short_help(translator& _, std::pmr::string& s) const
 			{
-				std::string aname;
+				std::pmr::string aname { _.resource() };
 				if (names().empty()) {
 					aname = meta_name(_);
 				} else {
@@ -167,9 +665,9 @@ namespace args {
 				}
 			}
 
-			std::string help_name(translator& _) const
+			std::pmr::string help_name(translator& _) const
 			{
-				std::string nmz;
+				std::pmr::string nmz { _.resource() };
 				bool first = true;
 				for (auto& name : names()) {
 					if (first) first = false;
@@ -194,48 +692,112 @@ namespace args {
 			}
 		};
 
+		// Everything an action allocates comes from the schema's arena and
+		// is released with it; choices and completer, which few actions
+		// use, are created on first assignment.
 		class action_base : public action {
-			bool visited_ = false;
+			struct extras {
+				choice_set choices;
+				completer complete;
+				explicit extras(std::pmr::memory_resource* mr) : choices { mr } {}
+			};
+
+			std::pmr::memory_resource* arena_;
+			const std::string_view* names_ = nullptr;
+			uint32_t name_count_ = 0;
 			bool required_ = true;
 			bool multiple_ = false;
-			std::vector<std::string> names_;
-			std::string meta_;
-			std::string help_;
+			std::string_view meta_;
+			std::string_view help_;
+			std::string_view env_;
+			extras* extras_ = nullptr;
 
-			static void pack(std::vector<std::string>&) {}
-			template <typename Name, typename... Names>
-			static void pack(std::vector<std::string>& dst, Name&& name, Names&&... names)
+			extras& more()
 			{
-				dst.emplace_back(std::forward<Name>(name));
-				pack(dst, std::forward<Names>(names)...);
+				if (!extras_)
+					extras_ = new (arena_->allocate(sizeof(extras), alignof(extras))) extras { arena_ };
+				return *extras_;
+			}
+
+			static const choice_set& no_choices()
+			{
+				static const choice_set none { std::pmr::null_memory_resource() };
+				return none;
+			}
+
+			static const completer& no_completer()
+			{
+				static const completer none { nullptr };
+				return none;
 			}
 
 		protected:
 			template <typename... Names>
-			action_base(Names&&... argnames)
+			action_base(std::pmr::memory_resource* arena, Names&&... argnames) : arena_ { arena }
 			{
-				pack(names_, std::forward<Names>(argnames)...);
+				if constexpr (sizeof...(Names) > 0) {
+					auto names = static_cast<std::string_view*>(arena->allocate(sizeof(std::string_view) * sizeof...(Names), alignof(std::string_view)));
+					size_t index = 0;
+					((new (names + index++) std::string_view { detail::keep(arena, str_ref { std::forward<Names>(argnames) }) }), ...);
+					names_ = names;
+					name_count_ = sizeof...(Names);
+				}
 			}
 
-			void visited(bool val) { visited_ = val; }
+			~action_base()
+			{
+				if (extras_)
+					extras_->~extras();
+			}
 		public:
+			action_base(const action_base&) = delete;
+			action_base& operator=(const action_base&) = delete;
+
 			void required(bool value) override { required_ = value; }
 			bool required() const override { return required_; }
 			void multiple(bool value) override { multiple_ = value; }
 			bool multiple() const override { return multiple_; }
 
-			void visit(parser&) override { visited_ = true; }
-			void visit(parser&, const std::string& /*arg*/) override { visited_ = true; }
-			bool visited() const override { return visited_; }
-			void meta(const std::string& s) override { meta_ = s; }
-			const std::string& meta() const override { return meta_; }
-			std::string meta_name(translator& _) const override { return meta_.empty() ? _(lng::def_meta) : meta_.c_str(); }
-			void help(const std::string& s) override { help_ = s; }
-			const std::string& help() const override { return help_; }
-
-			bool is(const std::string& name) const override
+			void visit(parser&, void* /*dst*/) override { }
+			bool visit(parser&, void* /*dst*/, std::string_view /*arg*/) override { return true; }
+			bool visit(parser& p, void* dst, std::string_view arg, size_t /*choice*/) override { return visit(p, dst, arg); }
+			bool accepts(std::string_view /*arg*/) const override { return true; }
+			void choices(std::initializer_list<std::string_view> names) override { more().choices.assign(names); }
+			const choice_set& choices() const override { return extras_ ? extras_->choices : no_choices(); }
+			void compile() override
+			{
+				if (extras_ && !extras_->choices.empty())
+					extras_->choices.build();
+			}
+			void meta(str_ref s) override { meta_ = detail::keep(arena_, s); }
+			std::string_view meta() const override { return meta_; }
+			std::pmr::string meta_name(translator& _) const override
+			{
+				if (!meta_.empty())
+					return std::pmr::string { meta_, _.resource() };
+				if (choices().empty())
+					return _(lng::def_meta);
+
+				std::pmr::string out { _.resource() };
+				out.push_back('{');
+				for (auto& name : choices().names()) {
+					if (out.length() > 1)
+						out.push_back(',');
+					out.append(name);
+				}
+				out.push_back('}');
+				return out;
+			}
+			void help(str_ref s) override { help_ = detail::keep(arena_, s); }
+			std::string_view help() const override { return help_; }
+			void env(str_ref name) override { env_ = detail::keep(arena_, name); }
+			std::string_view env() const override { return env_; }
+			void complete(completer cb) override { more().complete = std::move(cb); }
+			const completer& complete() const override { return extras_ ? extras_->complete : no_completer(); }
+
+			bool is(std::string_view name) const override
 			{
-				for (auto& argname : names_) {
+				for (auto& argname : names()) {
 					if (argname.length() > 1 && argname == name)
 						return true;
 				}
@@ -245,7 +807,7 @@ namespace args {
 
 			bool is(char name) const override
 			{
-				for (auto& argname : names_) {
+				for (auto& argname : names()) {
 					if (argname.length() == 1 && argname[0] == name)
 						return true;
 				}
@@ -253,164 +815,257 @@ namespace args {
 				return false;
 			}
 
-			const std::vector<std::string>& names() const override
+			detail::name_list names() const override
 			{
-				return names_;
+				return { names_, name_count_ };
 			}
 		};
 
+		// Edits go through the schema, which recompiles on the next parse.
+		// A schema returned by parser::share() rejects them; a builder
+		// returned after share() has no action and ignores every edit.
 		class builder {
+			friend class ::args::schema;
 			friend class ::args::parser;
 
-			actions::action* ptr;
-			builder(actions::action* ptr) : ptr(ptr) { }
+			schema* owner_;
+			size_t id_;
+			builder(schema* owner, size_t id) : owner_(owner), id_(id) { }
 			builder(const builder&);
+			inline action* edit() const;
 		public:
 			builder(builder&&) = default;
-			builder& meta(const std::string& name)
+			size_t id() const { return id_; }
+			builder& meta(str_ref name)
 			{
-				ptr->meta(name);
+				if (auto ptr = edit())
+					ptr->meta(name);
 				return *this;
 			}
-			builder& help(const std::string& dscr)
+			builder& help(str_ref dscr)
 			{
-				ptr->help(dscr);
+				if (auto ptr = edit())
+					ptr->help(dscr);
 				return *this;
 			}
 			builder& multi(bool value = true)
 			{
-				ptr->multiple(value);
+				if (auto ptr = edit())
+					ptr->multiple(value);
 				return *this;
 			}
 			builder& req(bool value = true)
 			{
-				ptr->required(value);
+				if (auto ptr = edit())
+					ptr->required(value);
 				return *this;
 			}
 			builder& opt(bool value = true)
 			{
-				ptr->required(!value);
+				if (auto ptr = edit())
+					ptr->required(!value);
+				return *this;
+			}
+			// Any callable taking (std::string_view prefix,
+			// std::pmr::vector<std::pmr::string>& out)
+			template <typename Callable>
+			builder& complete(Callable cb);
+			// Enum destinations receive the index of the matching choice,
+			// others the value itself.
+			builder& choices(std::initializer_list<std::string_view> names)
+			{
+				if (auto ptr = edit())
+					ptr->choices(names);
+				return *this;
+			}
+			// Used when the argument is missing from the command line; the
+			// command line wins over the variable, the variable over the
+			// destination's initial value. Flags are set by any value
+			// except an empty one and "0"; a multi-value destination gets
+			// the whole variable as its only value. The variable is ignored
+			// when the command line gives an option excluded with this one.
+			builder& env(str_ref name)
+			{
+				if (auto ptr = edit())
+					ptr->env(name);
 				return *this;
 			}
 		};
 
+		// Leaves dst untouched and returns false when arg is not a number
+		// the integral or enum dst can hold. An enum dst takes the index of
+		// a matching choice instead.
+		template <typename T>
+		inline bool store_value(T& dst, std::string_view arg, size_t choice)
+		{
+			if constexpr (std::is_enum<T>::value || std::is_integral<T>::value) {
+				if (std::is_enum<T>::value && choice != choice_set::npos) {
+					dst = static_cast<T>(choice);
+					return true;
+				}
+
+				typename std::conditional_t<std::is_enum<T>::value, std::underlying_type<T>, std::common_type<T>>::type value { };
+				auto end = arg.data() + arg.length();
+				auto res = std::from_chars(arg.data(), end, value);
+				if (res.ec != std::errc { } || res.ptr != end)
+					return false;
+				dst = static_cast<T>(value);
+			} else if constexpr (std::is_assignable<T&, std::string_view>::value)
+				dst = arg;
+			else
+				dst = std::string { arg };
+			return true;
+		}
+
+		template <typename T>
+		inline bool valid_value(std::string_view arg)
+		{
+			if constexpr (std::is_enum<T>::value || std::is_integral<T>::value) {
+				T value { };
+				return store_value(value, arg, choice_set::npos);
+			} else
+				return true;
+		}
+
 		template <typename T>
 		class store_action : public action_base {
-			T* ptr;
 		public:
 			template <typename... Names>
-			explicit store_action(T* dst, Names&&... names) : action_base(std::forward<Names>(names)...), ptr(dst) {}
+			explicit store_action(std::pmr::memory_resource* mr, Names&&... names) : action_base(mr, std::forward<Names>(names)...) {}
 
 			bool needs_arg() const override { return true; }
-			void visit(parser&, const std::string& arg) override
+			bool visit(parser&, void* dst, std::string_view arg) override
+			{
+				return store_value(*static_cast<T*>(dst), arg, choice_set::npos);
+			}
+			bool visit(parser&, void* dst, std::string_view arg, size_t choice) override
+			{
+				return store_value(*static_cast<T*>(dst), arg, choice);
+			}
+			bool accepts(std::string_view arg) const override
 			{
-				*ptr = arg;
-				visited(true);
+				return valid_value<T>(arg);
 			}
 		};
 
 		template <typename T>
 		class store_action<std::vector<T>> final : public action_base {
-			std::vector<T>* ptr;
 		public:
 			template <typename... Names>
-			explicit store_action(std::vector<T>* dst, Names&&... names) : action_base(std::forward<Names>(names)...), ptr(dst)
+			explicit store_action(std::pmr::memory_resource* mr, Names&&... names) : action_base(mr, std::forward<Names>(names)...)
 			{
 				action_base::multiple(true);
 			}
 
 			bool needs_arg() const override { return true; }
-			void visit(parser&, const std::string& arg) override
+			bool visit(parser& p, void* dst, std::string_view arg) override
+			{
+				return visit(p, dst, arg, choice_set::npos);
+			}
+			bool visit(parser&, void* dst, std::string_view arg, size_t choice) override
+			{
+				auto& out = *static_cast<std::vector<T>*>(dst);
+				if constexpr (std::is_enum<T>::value || std::is_integral<T>::value) {
+					T value { };
+					if (!store_value(value, arg, choice))
+						return false;
+					out.push_back(value);
+				} else if constexpr (std::is_constructible<T, std::string_view>::value)
+					out.emplace_back(arg);
+				else
+					out.emplace_back(std::string { arg });
+				return true;
+			}
+			bool accepts(std::string_view arg) const override
 			{
-				ptr->push_back(arg);
-				visited(true);
+				return valid_value<T>(arg);
 			}
 		};
 
 		template <typename T, typename Value>
 		class value_action : public action_base {
-			T* ptr;
 		public:
 			template <typename... Names>
-			explicit value_action(T* dst, Names&&... names) : action_base(std::forward<Names>(names)...), ptr(dst)
+			explicit value_action(std::pmr::memory_resource* mr, Names&&... names) : action_base(mr, std::forward<Names>(names)...)
 			{
 			}
 
 			bool needs_arg() const override { return false; }
-			void visit(parser&) override
+			void visit(parser&, void* dst) override
 			{
-				*ptr = Value::value;
-				visited(true);
+				*static_cast<T*>(dst) = Value::value;
 			}
 		};
 
-		namespace detail {
-			template <typename Callable, bool Forward, typename... Args>
-			class custom_adapter_impl {
-			public:
-				custom_adapter_impl(Callable cb) : cb(std::move(cb))
-				{
-				}
-				void operator()(parser& p, Args&&... args)
-				{
-					cb(p, std::forward<Args>(args)...);
-				}
-			private:
-				Callable cb;
-			};
-
-			template <typename Callable, typename... Args>
-			class custom_adapter_impl<Callable, false, Args...> {
-			public:
-				custom_adapter_impl(Callable cb) : cb(std::move(cb))
-				{
-				}
-				void operator()(parser&, Args&&... args)
-				{
-					cb(std::forward<Args>(args)...);
-				}
-			private:
-				Callable cb;
-			};
-
-			template <typename Callable, typename... Args>
-			using custom_adapter = custom_adapter_impl<
-				Callable,
-				stdex::is_callable<void(parser&, Args...), Callable>::value,
-				Args...>;
-		}
-
-		template <typename Callable, typename Enable = void> class custom_action;
-
-		template <typename Callable>
-		class custom_action<Callable, std::enable_if_t<stdex::is_callable_or<Callable, void(), void(parser&)>::value>> : public action_base {
-			detail::custom_adapter<Callable> cb;
+		// Every parser::custom callback becomes this one type; the callable
+		// is adapted to void(parser&, std::string_view) and stored in place.
+		class custom_action : public action_base {
+		public:
+			using callback = stdex::inplace_function<void(parser&, std::string_view), ARGS_CUSTOM_CAPACITY>;
+		private:
+			callback cb;
+			bool needs_arg_;
 		public:
 			template <typename... Names>
-			explicit custom_action(Callable cb, Names&&... names) : action_base(std::forward<Names>(names)...), cb(std::move(cb)) {}
+			explicit custom_action(std::pmr::memory_resource* mr, callback cb, bool needs_arg, Names&&... names) : action_base(mr, std::forward<Names>(names)...), cb(std::move(cb)), needs_arg_ { needs_arg } {}
 
-			bool needs_arg() const override { return false; }
-			void visit(parser& p) override
+			bool needs_arg() const override { return needs_arg_; }
+			void visit(parser& p, void*) override
 			{
-				cb(p);
-				visited(true);
+				cb(p, { });
+			}
+			bool visit(parser& p, void*, std::string_view s) override
+			{
+				cb(p, s);
+				return true;
 			}
 		};
 
-		template <typename Callable>
-		class custom_action<Callable, std::enable_if_t<stdex::is_callable_or<Callable, void(const std::string&), void(parser&, const std::string&)>::value>> : public action_base {
-			detail::custom_adapter<Callable> cb;
-		public:
-			template <typename... Names>
-			explicit custom_action(Callable cb, Names&&... names) : action_base(std::forward<Names>(names)...), cb(std::move(cb)) {}
+		namespace detail {
+			template <typename Callable>
+			inline constexpr bool fits_in_place =
+				sizeof(Callable) <= ARGS_CUSTOM_CAPACITY &&
+				alignof(Callable) <= alignof(std::max_align_t) &&
+				std::is_nothrow_move_constructible<Callable>::value;
+
+			// Holds a callable that does not fit the callback in place
+			template <typename Callable>
+			struct boxed {
+				args::detail::pmr_ptr<Callable> target;
+
+				template <typename... Args>
+				auto operator()(Args&&... args) -> decltype(std::declval<Callable&>()(std::forward<Args>(args)...))
+				{
+					return (*target)(std::forward<Args>(args)...);
+				}
+			};
 
-			bool needs_arg() const override { return true; }
-			void visit(parser& p, const std::string& s) override
+			// Function is an inplace_function; callables too big for it,
+			// over-aligned or throwing on move are allocated from mr
+			template <typename Function, typename Callable>
+			Function in_place(Callable cb, std::pmr::memory_resource* mr)
 			{
-				cb(p, s);
-				visited(true);
+				if constexpr (std::is_same<Callable, Function>::value || fits_in_place<Callable>)
+					return Function { std::move(cb) };
+				else
+					return Function { boxed<Callable> { args::detail::pmr_make<Callable>(mr, std::move(cb)) } };
 			}
-		};
+
+			// Adapts any signature parser::custom accepts
+			template <typename Callable>
+			custom_action::callback custom_callback(Callable cb, std::pmr::memory_resource* mr)
+			{
+				using callback = custom_action::callback;
+				if constexpr (stdex::is_callable_v<void(parser&), Callable&>)
+					return in_place<callback>([cb = std::move(cb)](parser& p, std::string_view) mutable { cb(p); }, mr);
+				else if constexpr (stdex::is_callable_v<void(), Callable&>)
+					return in_place<callback>([cb = std::move(cb)](parser&, std::string_view) mutable { cb(); }, mr);
+				else if constexpr (stdex::is_callable_v<void(parser&, const std::string&), Callable&>)
+					return in_place<callback>([cb = std::move(cb)](parser& p, std::string_view s) mutable { cb(p, std::string { s }); }, mr);
+				else
+					return in_place<callback>([cb = std::move(cb)](parser&, std::string_view s) mutable { cb(std::string { s }); }, mr);
+			}
+		}
 	}
 
 	namespace detail {
@@ -437,40 +1092,371 @@ namespace args {
 #endif
 		}
 
-		template <typename It>
-		inline It split(It cur, It end, size_t width)
+#ifdef ARGS_SSE2
+		inline unsigned first_bit(unsigned mask)
 		{
-			if (size_t(end - cur) <= width)
-				return end;
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+#else
+			return __builtin_ctz(mask);
+#endif
+		}
 
-			auto c_end = cur + width;
-			auto it = cur;
-			while (true) {
-				auto prev = it;
-				while (it != c_end && *it == ' ') ++it;
-				while (it != c_end && *it != ' ') ++it;
-				if (it == c_end) {
-					if (prev == cur || *c_end == ' ')
-						return c_end;
-					return prev;
-				}
+		template <typename Pred>
+		inline const char* scan(const char* cur, const char* end, Pred&& pred, unsigned (*block_mask)(__m128i))
+		{
+			for (; end - cur >= 16; cur += 16) {
+				auto mask = block_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cur)));
+				if (mask)
+					return cur + first_bit(mask);
 			}
+			while (cur != end && !pred(*cur)) ++cur;
+			return cur;
 		}
 
-		template <typename It>
-		inline It skip_ws(It cur, It end)
+		inline const char* find_space(const char* cur, const char* end)
+		{
+			return scan(cur, end, [](char c) { return c == ' '; }, [](__m128i block) {
+				return unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(' '))));
+			});
+		}
+
+		inline const char* skip_space(const char* cur, const char* end)
+		{
+			return scan(cur, end, [](char c) { return c != ' '; }, [](__m128i block) {
+				return ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')))) & 0xFFFF;
+			});
+		}
+
+		inline const char* find_non_ascii(const char* cur, const char* end)
+		{
+			return scan(cur, end, [](char c) { return (c & 0x80) != 0; }, [](__m128i block) {
+				return unsigned(_mm_movemask_epi8(block));
+			});
+		}
+#else
+		inline const char* find_space(const char* cur, const char* end)
+		{
+			while (cur != end && *cur != ' ') ++cur;
+			return cur;
+		}
+
+		inline const char* skip_space(const char* cur, const char* end)
 		{
 			while (cur != end && *cur == ' ') ++cur;
 			return cur;
 		}
+
+		inline const char* find_non_ascii(const char* cur, const char* end)
+		{
+			while (cur != end && !(*cur & 0x80)) ++cur;
+			return cur;
+		}
+#endif
+
+		inline char32_t utf8_next(const char*& cur, const char* end)
+		{
+			auto lead = static_cast<unsigned char>(*cur++);
+			if (lead < 0x80)
+				return lead;
+
+			int trail = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+			if (trail < 0 || lead >= 0xF8 || end - cur < trail)
+				return 0xFFFD;
+
+			char32_t ch = lead & (0x3F >> trail);
+			for (int i = 0; i < trail; ++i) {
+				auto c = static_cast<unsigned char>(cur[i]);
+				if ((c & 0xC0) != 0x80)
+					return 0xFFFD;
+				ch = (ch << 6) | (c & 0x3F);
+			}
+			cur += trail;
+			return ch;
+		}
+
+		inline size_t char_width(char32_t ch)
+		{
+			struct range { char32_t lo, hi; };
+			static constexpr range zero[] = {
+				{ 0x0300, 0x036F }, { 0x1AB0, 0x1AFF }, { 0x1DC0, 0x1DFF }, { 0x200B, 0x200F },
+				{ 0x20D0, 0x20FF }, { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F },
+			};
+			static constexpr range wide[] = {
+				{ 0x1100, 0x115F }, { 0x2E80, 0x303E }, { 0x3041, 0x33FF }, { 0x3400, 0x4DBF },
+				{ 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF },
+				{ 0xFE30, 0xFE4F }, { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 }, { 0x1F300, 0x1F64F },
+				{ 0x1F900, 0x1F9FF }, { 0x20000, 0x2FFFD }, { 0x30000, 0x3FFFD },
+			};
+
+			if (ch < 0x0300)
+				return 1;
+			for (auto& r : zero) {
+				if (ch >= r.lo && ch <= r.hi)
+					return 0;
+			}
+			for (auto& r : wide) {
+				if (ch >= r.lo && ch <= r.hi)
+					return 2;
+			}
+			return 1;
+		}
+
+		// Returns the longest prefix of [cur, end) fitting in width columns;
+		// combining characters stay with the character they modify.
+		inline const char* advance(const char* cur, const char* end, size_t width)
+		{
+			while (cur != end) {
+				auto limit = size_t(end - cur) > width ? cur + width : end;
+				auto next = find_non_ascii(cur, limit);
+				width -= next - cur;
+				cur = next;
+				if (cur == end || !(*cur & 0x80)) {
+					if (!width)
+						break;
+					continue;
+				}
+
+				auto ch = utf8_next(next, end);
+				auto w = char_width(ch);
+				if (w > width)
+					break;
+				width -= w;
+				cur = next;
+			}
+
+			while (cur != end && (*cur & 0x80)) {
+				auto next = cur;
+				if (char_width(utf8_next(next, end)))
+					break;
+				cur = next;
+			}
+
+			return cur;
+		}
+
+		inline size_t display_width(std::string_view text)
+		{
+			auto cur = text.data();
+			auto end = cur + text.length();
+			size_t width = 0;
+			while (cur != end) {
+				auto next = find_non_ascii(cur, end);
+				width += next - cur;
+				cur = next;
+				if (cur != end)
+					width += char_width(utf8_next(cur, end));
+			}
+			return width;
+		}
+
+		inline const char* split(const char* cur, const char* end, size_t width)
+		{
+			auto c_end = advance(cur, end, width);
+			if (c_end == end)
+				return end;
+
+			if (c_end == cur) {
+				utf8_next(c_end, end);
+				return c_end;
+			}
+
+			auto it = cur;
+			while (true) {
+				auto prev = it;
+				it = find_space(skip_space(it, c_end), c_end);
+				if (it == c_end) {
+					if (prev == cur || *c_end == ' ')
+						return c_end;
+					return prev;
+				}
+			}
+		}
+
+		// The scanners read the text as one block of chars, so only
+		// iterators over contiguous chars may stand in for pointers
+		template <typename It, typename... Containers>
+		using iterator_of = std::disjunction<
+			std::is_same<It, typename Containers::iterator>...,
+			std::is_same<It, typename Containers::const_iterator>...>;
+
+#if defined(__cpp_lib_concepts)
+		template <typename It>
+		inline constexpr bool contiguous_chars = std::contiguous_iterator<It> && std::is_same<std::iter_value_t<It>, char>::value;
+#else
+		template <typename It>
+		inline constexpr bool contiguous_chars =
+			(std::is_pointer<It>::value && std::is_same<std::remove_const_t<std::remove_pointer_t<It>>, char>::value) ||
+			iterator_of<It, std::string, std::pmr::string, std::string_view, std::vector<char>, std::pmr::vector<char>>::value;
+#endif
+
+		template <typename It, typename = std::enable_if_t<contiguous_chars<It>>>
+		inline It split(It cur, It end, size_t width)
+		{
+			if (cur == end)
+				return end;
+			auto ptr = static_cast<const char*>(&*cur);
+			return cur + (split(ptr, ptr + (end - cur), width) - ptr);
+		}
+
+		template <typename It, typename = std::enable_if_t<contiguous_chars<It>>>
+		inline It skip_ws(It cur, It end)
+		{
+			if (cur == end)
+				return end;
+			auto ptr = static_cast<const char*>(&*cur);
+			return cur + (skip_space(ptr, ptr + (end - cur)) - ptr);
+		}
+
+		inline std::pmr::string expand(std::pmr::memory_resource* mr, char c)
+		{
+			char buff[] = { '-', c, 0 };
+			return { buff, mr };
+		}
+
+		inline std::pmr::string expand(std::pmr::memory_resource* mr, std::string_view name)
+		{
+			std::pmr::string out { mr };
+			out.reserve(name.length() + 2);
+			out.append("--").append(name);
+			return out;
+		}
+
+		struct parse_stop {
+			result res;
+		};
+
+		// One address per type, identifying a destination's type without RTTI
+		template <typename T>
+		struct type_tag {
+			static constexpr char id = 0;
+		};
+
+		template <typename T>
+		constexpr const void* type_of() { return &type_tag<T>::id; }
+
+		inline const char* const* environment()
+		{
+#ifdef _WIN32
+			return _environ;
+#else
+			return environ;
+#endif
+		}
+
+		struct no_count {
+			void operator()() const { }
+		};
+
+		inline size_t lowest_bit(uint64_t bits)
+		{
+#if defined(__GNUC__)
+			return static_cast<size_t>(__builtin_ctzll(bits));
+#else
+			size_t index = 0;
+			while (!(bits & 1)) {
+				bits >>= 1;
+				++index;
+			}
+			return index;
+#endif
+		}
+
+		// Lowest bit at or after from set in op(mask[i], visited[i]).
+		template <typename Op>
+		inline size_t find_bit(const uint64_t* mask, const uint64_t* visited, size_t words, size_t from, Op op)
+		{
+			for (auto word = from / 64; word < words; ++word) {
+				auto bits = op(mask[word], visited[word]);
+				if (word == from / 64)
+					bits &= ~uint64_t(0) << (from % 64);
+				if (bits)
+					return word * 64 + lowest_bit(bits);
+			}
+			return size_t(-1);
+		}
+
+#ifdef ARGS_INSTRUMENT
+		class counting_resource : public std::pmr::memory_resource {
+			std::pmr::memory_resource* upstream_;
+		public:
+			size_t allocations = 0;
+			size_t allocated = 0;
+
+			explicit counting_resource(std::pmr::memory_resource* upstream) : upstream_ { upstream } {}
+		private:
+			void* do_allocate(size_t bytes, size_t align) override
+			{
+				++allocations;
+				allocated += bytes;
+				return upstream_->allocate(bytes, align);
+			}
+
+			void do_deallocate(void* ptr, size_t bytes, size_t align) override
+			{
+				upstream_->deallocate(ptr, bytes, align);
+			}
+
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+			{
+				return this == &other;
+			}
+		};
+
+		// Pauses the enclosing phase while running, so nested phases are
+		// never counted twice.
+		class phase_timer {
+			using clock = std::chrono::steady_clock;
+
+			std::chrono::nanoseconds& slot_;
+			phase_timer*& active_;
+			phase_timer* parent_;
+			clock::time_point start_;
+		public:
+			phase_timer(stats& data, stats::phase id, phase_timer*& active)
+				: slot_ { data.time[id] }, active_ { active }, parent_ { active }
+			{
+				start_ = clock::now();
+				if (parent_)
+					parent_->flush(start_);
+				active_ = this;
+			}
+
+			~phase_timer()
+			{
+				auto now = clock::now();
+				flush(now);
+				active_ = parent_;
+				if (parent_)
+					parent_->start_ = now;
+			}
+
+			phase_timer(const phase_timer&) = delete;
+			phase_timer& operator=(const phase_timer&) = delete;
+
+			void flush(clock::time_point now = clock::now())
+			{
+				slot_ += now - start_;
+				start_ = now;
+			}
+		};
+
+#	define ARGS_PHASE(NAME) detail::phase_timer args_phase_ { stats_, stats::NAME, phase_ }
+#	define ARGS_COUNT(FIELD) (++stats_.FIELD)
+#else
+#	define ARGS_PHASE(NAME) ((void)0)
+#	define ARGS_COUNT(FIELD) ((void)0)
+#endif
 	}
 
 	struct chunk {
-		std::string title;
-		std::vector<std::pair<std::string, std::string>> items;
+		std::pmr::string title;
+		std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>> items;
 	};
 
-	using fmt_list = std::vector<chunk>;
+	using fmt_list = std::pmr::vector<chunk>;
 
 	struct file_printer {
 		file_printer(FILE* out) : out(out)
@@ -498,7 +1484,15 @@ namespace args {
 	template <typename output>
 	struct printer_base_impl : output {
 		using output::output;
-		inline void format_paragraph(const std::string& text, size_t indent, size_t width)
+		inline void pad(size_t count)
+		{
+			static constexpr char spaces[] = "                                ";
+			constexpr size_t chunk = sizeof(spaces) - 1;
+			for (; count > chunk; count -= chunk)
+				output::print(spaces, chunk);
+			output::print(spaces, count);
+		}
+		inline void format_paragraph(std::string_view text, size_t indent, size_t width)
 		{
 			if (width < 2)
 				width = text.length();
@@ -508,24 +1502,23 @@ namespace args {
 			if (indent >= width)
 				indent = 0;
 
-			auto cur = text.begin();
-			auto end = text.end();
+			auto cur = text.data();
+			auto end = cur + text.length();
 			auto chunk = detail::split(cur, end, width);
 
-			output::print(&*cur, chunk - cur);
+			output::print(cur, chunk - cur);
 			output::putc('\n');
 
 			cur = detail::skip_ws(chunk, end);
 			if (cur == end)
 				return;
 
-			std::string pre(indent, ' ');
 			width -= (int)indent;
 
 			while (cur != end) {
 				chunk = detail::split(cur, end, width);
-				output::print(pre.c_str(), pre.length());
-				output::print(&*cur, chunk - cur);
+				pad(indent);
+				output::print(cur, chunk - cur);
 				output::putc('\n');
 				cur = detail::skip_ws(chunk, end);
 			}
@@ -535,8 +1528,9 @@ namespace args {
 			size_t len = 0;
 			for (auto& chunk : info) {
 				for (auto& pair : chunk.items) {
-					if (len < std::get<0>(pair).length())
-						len = std::get<0>(pair).length();
+					auto name_width = detail::display_width(std::get<0>(pair));
+					if (len < name_width)
+						len = name_width;
 				}
 			}
 
@@ -548,8 +1542,7 @@ namespace args {
 					for (auto& pair : chunk.items) {
 						output::putc(' ');
 						output::print(std::get<0>(pair).c_str(), std::get<0>(pair).length());
-						for (size_t i = 0, max = len - std::get<0>(pair).length() + 1; i < max; ++i)
-							output::putc(' ');
+						pad(len - detail::display_width(std::get<0>(pair)) + 1);
 						output::print(std::get<1>(pair).c_str(), std::get<1>(pair).length());
 						output::putc('\n');
 					}
@@ -565,17 +1558,22 @@ namespace args {
 			len -= 2;
 
 			for (auto& chunk : info) {
+				std::pmr::string title { chunk.title.get_allocator() };
+				title.reserve(chunk.title.length() + 1);
+				title.append(chunk.title).push_back(':');
+
 				output::putc('\n');
-				format_paragraph(chunk.title + ":", 0, width);
+				format_paragraph(title, 0, width);
 				for (auto& pair : chunk.items) {
-					auto prefix = (len < std::get<0>(pair).length() ? std::get<0>(pair).length() : len) + 2;
+					auto name_width = detail::display_width(std::get<0>(pair));
+					auto prefix = (len < name_width ? name_width : len) + 2;
 
-					std::string sum;
-					sum.reserve(prefix + std::get<1>(pair).length());
+					std::pmr::string sum { chunk.items.get_allocator() };
+					sum.reserve(prefix + std::get<0>(pair).length() + std::get<1>(pair).length());
 					sum.push_back(' ');
 					sum.append(std::get<0>(pair));
 					// prefix - (initial space + the value for the first column)
-					sum.append(prefix - 1 - std::get<0>(pair).length(), ' ');
+					sum.append(prefix - 1 - name_width, ' ');
 					sum.append(std::get<1>(pair));
 					format_paragraph(sum, prefix, width);
 				}
@@ -593,7 +1591,7 @@ namespace args {
 		using printer_base_impl<file_printer>::printer_base_impl;
 		using printer_base_impl<file_printer>::format_paragraph;
 		using printer_base_impl<file_printer>::format_list;
-		inline void format_paragraph(const std::string& text, size_t indent)
+		inline void format_paragraph(std::string_view text, size_t indent)
 		{
 			format_paragraph(text, indent, width());
 		}
@@ -603,278 +1601,1557 @@ namespace args {
 		}
 	};
 
+	struct string_printer {
+		string_printer(std::pmr::string& out) : out(out)
+		{
+		}
+		void print(const char* cur, size_t len)
+		{
+			out.append(cur, len);
+		}
+		void putc(char c)
+		{
+			out.push_back(c);
+		}
+		size_t width()
+		{
+			return 0;
+		}
+	private:
+		std::pmr::string& out;
+	};
+
 	using printer = printer_base<file_printer>;
 
-	class parser {
-		std::vector<std::unique_ptr<actions::action>> actions_;
-		std::string description_;
-		std::vector<const char*> args_;
-		std::string prog_;
-		std::string usage_;
+	class schema {
+		friend class parser;
+		friend class actions::builder;
+	public:
+		// builder::id() of an action registered after share()
+		static constexpr size_t npos = size_t(-1);
+	private:
+		std::pmr::memory_resource* mr_;
+		// actions and their text, released together with the schema
+		detail::arena_resource arena_;
+		std::pmr::vector<actions::action*> actions_;
+		struct target {
+			void* ptr;
+			const void* type; // detail::type_of<void> for custom actions
+		};
+		std::pmr::vector<target> targets_;
+		std::pmr::string description_;
+		std::pmr::string usage_;
 		bool provide_help_ = true;
-		translator m_tr;
+		bool provide_completion_ = false;
+
+		struct command {
+			std::pmr::string name;
+			std::pmr::string help;
+			command_factory factory;
+			// what the factory registered, built by command_schema()
+			mutable std::shared_ptr<const schema> built;
+		};
+		std::pmr::vector<command> commands_;
+		mutable std::mutex commands_lock_;
+
+		struct constraint {
+			enum kind {
+				exclusive,
+				at_least_one,
+				depends,
+				conflicts
+			};
 
-#ifdef _WIN32
-		static constexpr char DIRSEP = '\\';
-#else
-		static constexpr char DIRSEP = '/';
-#endif
-		std::string program_name(const char* arg0)
+			kind type;
+			size_t subject;
+			std::pmr::vector<size_t> ids;
+		};
+		std::pmr::vector<constraint> constraints_;
+
+		bool indexed_ = false;
+		// answered a completion query by scanning, see complete_find()
+		bool completed_ = false;
+		bool compiled_ = false;
+		bool shared_ = false;
+		// bumped by every change, so parsers can tell their rendered help is stale
+		size_t generation_ = 0;
+		size_t words_ = 0;
+		// words_ for the required actions, then words_ for each constraint
+		std::pmr::vector<uint64_t> masks_;
+		std::pmr::vector<std::pair<std::string_view, size_t>> long_;
+		std::array<size_t, 256> short_;
+		size_t positional_ = npos;
+		std::pmr::vector<std::pair<std::string_view, size_t>> command_index_;
+		std::pmr::vector<std::pair<std::string_view, size_t>> env_index_;
+
+		void touch()
 		{
-			auto program = std::strrchr(arg0, DIRSEP);
-			if (program) ++program;
-			else program = arg0;
-
-#ifdef WIN32
-			auto ext = std::strrchr(program, '.');
-			if (ext && ext != program)
-				return { program, ext };
-#endif
-
-			return program;
+			indexed_ = compiled_ = false;
+			++generation_;
 		}
 
-		std::pair<size_t, size_t> count_args() const
+		template <typename T, typename Target, typename... Args>
+		actions::builder add(Target* target, Args&&... args)
 		{
-			size_t positionals = 0;
-			size_t arguments = provide_help_ ? 1 : 0;
-
-			for (auto& action : actions_) {
-				if (action->names().empty())
-					++positionals;
-				else
-					++arguments;
+			touch();
+			auto action = new (arena_.allocate(sizeof(T), alignof(T))) T(&arena_, std::forward<Args>(args)...);
+			try {
+				actions_.push_back(action);
+			} catch (...) {
+				action->~T();
+				throw;
 			}
-
-			return { positionals, arguments };
+			targets_.push_back({ target, detail::type_of<Target>() });
+			return { this, actions_.size() - 1 };
 		}
 
-		static chunk& make_title(chunk& part, std::string title, size_t count)
+		void add_command(std::string_view name, std::string_view help, command_factory factory)
 		{
-			part.title = std::move(title);
-			part.items.reserve(count);
-			return part;
+			touch();
+			commands_.push_back({ std::pmr::string { name, mr_ }, std::pmr::string { help, mr_ }, std::move(factory), nullptr });
 		}
 
-		static std::string expand(char c)
+		// nullptr once shared
+		actions::action* edit(size_t id)
 		{
-			char buff[] = { '-', c, 0 };
-			return buff;
+			assert(!shared_ && "shared args::schema cannot be changed");
+			if (shared_)
+				return nullptr;
+			touch();
+			return actions_[id];
 		}
 
-		void parse_long(const std::string& name, size_t& i)
+		// A constraint naming an unknown action is dropped
+		void constrain(constraint::kind type, size_t subject, std::initializer_list<size_t> ids)
 		{
-			if (provide_help_ && name == "help")
-				help();
-
-			for (auto& action : actions_) {
-				if (!action->is(name))
-					continue;
-
-				if (action->needs_arg()) {
-					++i;
-					if (i >= args_.size())
-						error(m_tr(lng::needs_param, "--" + name));
-
-					action->visit(*this, args_[i]);
-				} else
-					action->visit(*this);
-
+			auto known = [&](size_t id) { return id < actions_.size(); };
+			auto valid = (type == constraint::exclusive || type == constraint::at_least_one ? subject == npos : known(subject))
+				&& std::all_of(ids.begin(), ids.end(), known);
+			assert(valid && "args constraint names an unknown action");
+			if (!valid)
 				return;
-			}
-
-			error(m_tr(lng::unrecognized, "--" + name));
+			touch();
+			constraints_.push_back({ type, subject, std::pmr::vector<size_t> { ids, mr_ } });
 		}
 
-		void parse_short(const std::string& name, size_t& arg)
+		// The name lookups, all that repeated completion queries need
+		void index()
 		{
-			auto length = name.length();
-			for (decltype(length) i = 0; i < length; ++i) {
-				auto c = name[i];
-				if (provide_help_ && c == 'h')
-					help();
-
-				bool found = false;
-				for (auto& action : actions_) {
-					if (!action->is(c))
-						continue;
+			// sorted by (name, id), so lookups find the first registered of
+			// duplicate names; std::sort needs no buffer, unlike stable_sort
+			long_.clear();
+			long_.reserve(actions_.size());
+			short_.fill(npos);
+			positional_ = npos;
+
+			for (size_t id = 0; id < actions_.size(); ++id) {
+				auto names = actions_[id]->names();
+				if (names.empty() && positional_ == npos)
+					positional_ = id;
+
+				for (auto& name : names) {
+					if (name.length() == 1) {
+						auto& slot = short_[static_cast<unsigned char>(name[0])];
+						if (slot == npos)
+							slot = id;
+					} else
+						long_.emplace_back(name, id);
+				}
+			}
 
-					if (action->needs_arg()) {
-						std::string param;
+			std::sort(long_.begin(), long_.end());
 
-						++i;
-						if (i < length)
-							param = name.substr(i);
-						else {
-							++arg;
-							if (arg >= args_.size())
-								error(m_tr(lng::needs_param, expand(c)));
+			command_index_.clear();
+			command_index_.reserve(commands_.size());
+			for (size_t id = 0; id < commands_.size(); ++id)
+				command_index_.emplace_back(commands_[id].name, id);
+			std::sort(command_index_.begin(), command_index_.end());
 
-							param = args_[arg];
-						}
+			indexed_ = true;
+		}
 
-						i = length;
+		void compile()
+		{
+			if (!indexed_)
+				index();
+
+			words_ = (actions_.size() + 63) / 64;
+			masks_.assign(words_ * (constraints_.size() + 1), 0);
+			auto set = [&](size_t mask, size_t id) {
+				assert(id < actions_.size() && "args constraint names an unknown action");
+				masks_[mask * words_ + id / 64] |= uint64_t(1) << (id % 64);
+			};
 
-						action->visit(*this, param);
-					} else
-						action->visit(*this);
+			for (size_t id = 0; id < actions_.size(); ++id) {
+				actions_[id]->compile();
+				if (actions_[id]->required())
+					set(0, id);
+			}
 
-					found = true;
-					break;
-				}
+			for (size_t index = 0; index < constraints_.size(); ++index) {
+				assert((constraints_[index].subject == npos || constraints_[index].subject < actions_.size()) && "args constraint names an unknown action");
+				for (auto id : constraints_[index].ids)
+					set(index + 1, id);
+			}
 
-				if (!found)
-					error(m_tr(lng::unrecognized, expand(c)));
+			env_index_.clear();
+			for (size_t id = 0; id < actions_.size(); ++id) {
+				auto name = actions_[id]->env();
+				if (!name.empty())
+					env_index_.emplace_back(name, id);
 			}
+			std::sort(env_index_.begin(), env_index_.end());
+
+			compiled_ = true;
 		}
 
-		void parse_positional(const std::string& value)
+		template <typename Index, typename Count>
+		static size_t lookup(const Index& index, std::string_view name, Count& count)
 		{
-			for (auto& action : actions_) {
-				if (!action->names().empty())
-					continue;
+			auto it = std::lower_bound(index.begin(), index.end(), name, [&](const auto& item, std::string_view name) {
+				count();
+				return item.first < name;
+			});
+			if (it == index.end())
+				return npos;
+			count();
+			return it->first == name ? it->second : npos;
+		}
 
-				action->visit(*this, value);
-				return;
-			}
+		// Runs the factory on first use and shares the result with every
+		// parser of this schema, on any thread
+		inline std::shared_ptr<const schema> command_schema(size_t id) const;
 
-			error(m_tr(lng::unrecognized, value));
+		template <typename Count = detail::no_count>
+		size_t find_command(std::string_view name, Count count = { }) const
+		{
+			return lookup(command_index_, name, count);
 		}
 
-		template <typename T, typename... Args>
-		actions::builder add(Args&&... args)
+		template <typename Count = detail::no_count>
+		size_t find(std::string_view name, Count count = { }) const
 		{
-			actions_.push_back(std::make_unique<T>(std::forward<Args>(args)...));
-			return actions_.back().get();
+			return lookup(long_, name, count);
 		}
-	public:
-		parser(const std::string& description, int argc, char* argv[], translator&& tr = { }) : description_(description), prog_ { program_name(argv[0]) }, m_tr { std::move(tr) }
+
+		size_t find(char name) const
 		{
-			args_.reserve(argc - 1);
-			for (int i = 1; i < argc; ++i)
-				args_.emplace_back(argv[i]);
+			return short_[static_cast<unsigned char>(name)];
 		}
 
-		template <typename T, typename... Names>
-		actions::builder arg(T& dst, Names&&... names) {
-			return add<actions::store_action<T>>(&dst, std::forward<Names>(names)...);
+		// Completion usually answers a single query in a fresh process, so
+		// until the schema is indexed, the lookups below scan the actions
+		// and commands instead of sorting them first.
+		size_t complete_find(std::string_view name) const
+		{
+			if (indexed_)
+				return find(name);
+			for (size_t id = 0; id < actions_.size(); ++id) {
+				for (auto& argname : actions_[id]->names()) {
+					if (argname.length() > 1 && argname == name)
+						return id;
+				}
+			}
+			return npos;
 		}
 
-		template <typename Value, typename T, typename... Names>
-		actions::builder set(T& dst, Names&&... names) {
-			return add<actions::value_action<T, Value>>(&dst, std::forward<Names>(names)...);
+		size_t complete_find(char name) const
+		{
+			if (indexed_)
+				return find(name);
+			for (size_t id = 0; id < actions_.size(); ++id) {
+				for (auto& argname : actions_[id]->names()) {
+					if (argname.length() == 1 && argname[0] == name)
+						return id;
+				}
+			}
+			return npos;
 		}
 
-		template <typename Callable, typename... Names>
-		std::enable_if_t<stdex::is_callable_or<Callable,
-			void(),
-			void(parser&),
-			void(const std::string&),
-			void(parser&, const std::string&)
-		>::value, actions::builder> custom(Callable cb, Names&&... names)
+		size_t complete_command(std::string_view name) const
 		{
-			return add<actions::custom_action<Callable>>(std::move(cb), std::forward<Names>(names)...);
+			if (indexed_)
+				return find_command(name);
+			for (size_t id = 0; id < commands_.size(); ++id) {
+				if (commands_[id].name == name)
+					return id;
+			}
+			return npos;
 		}
 
-		void program(const std::string& value) { prog_ = value; }
-		const std::string& program() { return prog_; }
+		size_t complete_positional() const
+		{
+			if (indexed_)
+				return positional_;
+			for (size_t id = 0; id < actions_.size(); ++id) {
+				if (actions_[id]->names().empty())
+					return id;
+			}
+			return npos;
+		}
 
-		void usage(const std::string& value) { usage_ = value; }
-		const std::string& usage() { return usage_; }
+		// Sorted names starting with prefix, duplicates included, as the
+		// indexes list them
+		template <typename Index, typename Scan>
+		void complete_names(const Index& index, std::string_view prefix, Scan scan, std::pmr::vector<std::string_view>& out) const
+		{
+			if (indexed_) {
+				auto it = std::lower_bound(index.begin(), index.end(), prefix, [](const auto& item, std::string_view name) { return item.first < name; });
+				for (; it != index.end() && it->first.substr(0, prefix.length()) == prefix; ++it)
+					out.push_back(it->first);
+				return;
+			}
 
-		void provide_help(bool value = true) { provide_help_ = value; }
-		bool provide_help() { return provide_help_; }
+			scan([&](std::string_view name) {
+				if (name.substr(0, prefix.length()) == prefix)
+					out.push_back(name);
+			});
+			std::sort(out.begin(), out.end());
+		}
+
+		// Whether an action the command line gave (set in given) rules id out
+		// through an exclusive group or a conflicts rule
+		bool excluded(size_t id, const uint64_t* given) const
+		{
+			auto has = [](const uint64_t* bits, size_t n) { return ((bits[n / 64] >> (n % 64)) & 1) != 0; };
+			auto present = [](uint64_t mask, uint64_t visited) { return mask & visited; };
+			auto mask = masks_.data();
+			for (auto& rule : constraints_) {
+				mask += words_;
+				switch (rule.type) {
+				case constraint::exclusive:
+					if (has(mask, id) && detail::find_bit(mask, given, words_, 0, present) != npos)
+						return true;
+					break;
+				case constraint::conflicts:
+					if (rule.subject == id ? detail::find_bit(mask, given, words_, 0, present) != npos : has(mask, id) && has(given, rule.subject))
+						return true;
+					break;
+				default:
+					break;
+				}
+			}
+			return false;
+		}
 
-		const std::vector<const char*>& args() const { return args_; }
+		// Whether a bare word goes to the positional instead of selecting
+		// the command it names (npos when it names none). A required
+		// positional takes the first such word; after that, and for an
+		// optional one, only words naming no command, and only one unless
+		// the positional takes many.
+		bool to_positional(size_t command, bool given) const
+		{
+			auto id = complete_positional();
+			if (id == npos)
+				return false;
+			if (command != npos)
+				return !given && actions_[id]->required();
+			return !given || actions_[id]->multiple();
+		}
 
-		void parse()
+		// Whether an option word makes the parser take the next word as its value
+		bool takes_next(std::string_view arg) const
 		{
-			auto count = args_.size();
-			for (decltype(count) i = 0; i < count; ++i) {
-				auto& arg = args_[i];
-				auto length = arg ? strlen(arg) : 0;
-				if (length > 1 && arg[0] == '-') {
-					if (length > 2 && arg[1] == '-')
-						parse_long(arg + 2, i);
-					else
-						parse_short(arg + 1, i);
-				} else
-					parse_positional(arg);
+			if (arg.length() > 2 && arg[1] == '-') {
+				auto id = complete_find(arg.substr(2));
+				return id != npos && actions_[id]->needs_arg();
 			}
 
-			for (auto& action : actions_) {
-				if (action->required() && !action->visited()) {
-					std::string arg;
-					if (action->names().empty()) {
-						arg = action->meta_name(m_tr);
-					} else {
-						auto& name = action->names().front();
-						arg = name.length() == 1 ? "-" + name : "--" + name;
+			for (size_t i = 1; i < arg.length(); ++i) {
+				auto id = complete_find(arg[i]);
+				if (id != npos && actions_[id]->needs_arg())
+					return i + 1 == arg.length();
+			}
+			return false;
+		}
+
+		void complete(std::string_view cur, std::string_view prev, std::pmr::vector<std::pmr::string>& out) const
+		{
+			size_t id = npos;
+			if (prev.length() > 2 && prev.substr(0, 2) == "--")
+				id = complete_find(prev.substr(2));
+			else if (prev.length() == 2 && prev[0] == '-')
+				id = complete_find(prev[1]);
+
+			if (id != npos && actions_[id]->needs_arg()) {
+				if (actions_[id]->complete())
+					actions_[id]->complete()(cur, out);
+				return;
+			}
+
+			std::pmr::vector<std::string_view> names { out.get_allocator().resource() };
+			if (cur.empty() || cur[0] != '-') {
+				auto positional = complete_positional();
+				if (!commands_.empty()) {
+					complete_names(command_index_, cur, [&](auto&& add) {
+						for (auto& cmd : commands_)
+							add(cmd.name);
+					}, names);
+					for (auto name : names)
+						out.emplace_back(name);
+				} else if (positional != npos && actions_[positional]->complete())
+					actions_[positional]->complete()(cur, out);
+				return;
+			}
+
+			if (cur.length() == 1) {
+				if (provide_help_)
+					out.emplace_back("-h");
+				std::array<bool, 256> present { };
+				for (size_t c = 0; indexed_ && c < short_.size(); ++c)
+					present[c] = short_[c] != npos;
+				for (size_t id = 0; !indexed_ && id < actions_.size(); ++id) {
+					for (auto& name : actions_[id]->names()) {
+						if (name.length() == 1)
+							present[static_cast<unsigned char>(name[0])] = true;
 					}
-					error(m_tr(lng::requires, arg));
 				}
+				for (size_t c = 0; c < present.size(); ++c) {
+					if (present[c])
+						out.emplace_back(1, '-').push_back(char(c));
+				}
+			} else if (cur[1] != '-') {
+				if (cur.length() == 2 && (complete_find(cur[1]) != npos || (provide_help_ && cur[1] == 'h')))
+					out.emplace_back(cur);
+				return;
 			}
+
+			auto prefix = cur.length() > 1 ? cur.substr(2) : std::string_view { };
+
+			if (provide_help_ && std::string_view { "help" }.substr(0, prefix.length()) == prefix)
+				out.emplace_back("--help");
+
+			complete_names(long_, prefix, [&](auto&& add) {
+				for (auto action : actions_) {
+					for (auto& name : action->names()) {
+						if (name.length() > 1)
+							add(name);
+					}
+				}
+			}, names);
+			for (auto name : names)
+				out.emplace_back("--").append(name);
 		}
 
-		void short_help(FILE* out = stdout)
+		std::pair<size_t, size_t> count_args() const
+		{
+			size_t positionals = 0;
+			size_t arguments = provide_help_ ? 1 : 0;
+
+			for (auto& action : actions_) {
+				if (action->names().empty())
+					++positionals;
+				else
+					++arguments;
+			}
+
+			return { positionals, arguments };
+		}
+	public:
+		explicit schema(std::string_view description, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: mr_ { mr }, arena_ { mr }, actions_ { mr }, targets_(mr), description_ { description, mr }, usage_ { mr }
+			, commands_ { mr }, constraints_ { mr }, masks_ { mr }, long_ { mr }, command_index_ { mr }, env_index_ { mr }
 		{
-			std::string shrt { m_tr(lng::usage) };
-			shrt.append(prog_);
+			short_.fill(npos);
+		}
+
+		~schema()
+		{
+			for (auto action : actions_)
+				action->~action();
+		}
+
+		std::pmr::memory_resource* resource() const { return mr_; }
+		size_t size() const { return actions_.size(); }
+		bool compiled() const { return compiled_; }
+		const actions::action& action(size_t id) const { return *actions_[id]; }
+		std::string_view description() const { return description_; }
+		std::string_view usage() const { return usage_; }
+		bool provide_help() const { return provide_help_; }
+	};
 
-			if (!usage_.empty()) {
-				shrt.push_back(' ');
-				shrt.append(usage_);
+	inline actions::action* actions::builder::edit() const
+	{
+		return owner_ ? owner_->edit(id_) : nullptr;
+	}
+
+	template <typename Callable>
+	inline actions::builder& actions::builder::complete(Callable cb)
+	{
+		if (auto ptr = edit())
+			ptr->complete(actions::detail::in_place<completer>(std::move(cb), owner_->resource()));
+		return *this;
+	}
+
+	class parser {
+#ifdef ARGS_INSTRUMENT
+		detail::pmr_ptr<detail::counting_resource> counter_;
+		stats stats_;
+		stats_callback report_;
+		detail::phase_timer* phase_ = nullptr;
+#endif
+		// the caller's resource, for anything that may outlive the parser
+		std::pmr::memory_resource* upstream_;
+		std::pmr::memory_resource* mr_;
+		std::shared_ptr<const schema> schema_;
+		schema* own_ = nullptr;
+		std::pmr::vector<void*> bindings_;
+		std::pmr::vector<uint64_t> visited_;
+		std::pmr::vector<const char*> args_;
+		std::pmr::string prog_;
+		const char* const* env_ = nullptr;
+		capture_sink* capture_ = nullptr;
+		bool exit_ = true;
+		result stop_;
+		translator m_tr;
+
+		size_t command_ = schema::npos;
+		// indexed by command id, created on first use
+		std::pmr::vector<detail::pmr_ptr<parser>> subs_;
+
+		// the short and the full help of the last width each was rendered
+		// for, valid for the schema and catalog generations they were
+		// rendered with
+		struct rendered {
+			size_t width;
+			std::pmr::string text;
+		};
+		std::pmr::string usage_line_;
+		rendered short_text_;
+		rendered full_text_;
+		size_t rendered_schema_ = 0;
+		size_t rendered_catalog_ = 0;
+
+#ifdef _WIN32
+		static constexpr char DIRSEP = '\\';
+#else
+		static constexpr char DIRSEP = '/';
+#endif
+		static std::string_view program_name(const char* arg0)
+		{
+			auto program = std::strrchr(arg0, DIRSEP);
+			if (program) ++program;
+			else program = arg0;
+
+#ifdef WIN32
+			auto ext = std::strrchr(program, '.');
+			if (ext && ext != program)
+				return { program, size_t(ext - program) };
+#endif
+
+			return program;
+		}
+
+		std::pmr::memory_resource* counted(std::pmr::memory_resource* mr)
+		{
+#ifdef ARGS_INSTRUMENT
+			counter_ = detail::pmr_make<detail::counting_resource>(mr, mr);
+			return counter_.get();
+#else
+			return mr;
+#endif
+		}
+
+		auto comparisons()
+		{
+#ifdef ARGS_INSTRUMENT
+			return [this] { ARGS_COUNT(comparisons); };
+#else
+			return detail::no_count { };
+#endif
+		}
+
+		void restart_stats()
+		{
+#ifdef ARGS_INSTRUMENT
+			auto registration = stats_.time[stats::registration];
+			stats_ = { };
+			stats_.time[stats::registration] = registration;
+			counter_->allocations = 0;
+			counter_->allocated = 0;
+#endif
+		}
+
+		void report()
+		{
+#ifdef ARGS_INSTRUMENT
+			if (phase_)
+				phase_->flush();
+			stats_.allocations = counter_->allocations;
+			stats_.allocated = counter_->allocated;
+			if (report_)
+				report_(stats_);
+#endif
+		}
+
+#ifdef ARGS_INSTRUMENT
+		struct report_guard {
+			parser& self;
+			~report_guard() { self.report(); }
+		};
+#endif
+
+		chunk& make_title(fmt_list& info, lng title, size_t count)
+		{
+			info.push_back({ m_tr(title), decltype(chunk::items) { mr_ } });
+			info.back().items.reserve(count);
+			return info.back();
+		}
+
+
+		// nullptr once the schema is shared
+		schema* edit()
+		{
+			assert(own_ && "shared args::schema cannot be changed");
+			if (own_)
+				invalidate();
+			return own_;
+		}
+
+		void invalidate()
+		{
+			usage_line_.clear();
+			short_text_.width = full_text_.width = schema::npos;
+		}
+
+		void drop_stale()
+		{
+			auto schema = schema_->generation_;
+			auto catalog = m_tr.generation();
+			if (schema != rendered_schema_ || catalog != rendered_catalog_) {
+				invalidate();
+				rendered_schema_ = schema;
+				rendered_catalog_ = catalog;
+			}
+		}
+
+		const std::pmr::string& usage_line()
+		{
+			drop_stale();
+			if (!usage_line_.empty())
+				return usage_line_;
+
+			usage_line_ = m_tr(lng::usage);
+			usage_line_.append(prog_);
+
+			if (!schema_->usage_.empty()) {
+				usage_line_.push_back(' ');
+				usage_line_.append(schema_->usage_);
 			} else {
-				if (provide_help_)
-					shrt.append(" [-h]");
+				if (schema_->provide_help_)
+					usage_line_.append(" [-h]");
 
-				for (auto& action : actions_)
-					action->append_short_help(m_tr, shrt);
+				for (auto& action : schema_->actions_)
+					action->append_short_help(m_tr, usage_line_);
+
+				if (!schema_->commands_.empty())
+					usage_line_.append(" ").append(m_tr(lng::command_meta)).append(" ...");
 			}
 
-			printer{ out }.format_paragraph(shrt, 7);
+			return usage_line_;
 		}
 
-		[[noreturn]] void help()
+		const std::pmr::string& render(bool full, size_t width)
+		{
+			ARGS_PHASE(rendering);
+			drop_stale();
+			auto& cached = full ? full_text_ : short_text_;
+			if (cached.width == width)
+				return cached.text;
+
+			cached.text.clear();
+			printer_base<string_printer> out { cached.text };
+			if (full)
+				help(out, width);
+			else
+				short_help(out, width);
+			cached.width = width;
+			return cached.text;
+		}
+
+		void* target(size_t id) const
+		{
+			return id < bindings_.size() ? bindings_[id] : schema_->targets_[id].ptr;
+		}
+
+		// One pass over the environment block, looking each variable up in
+		// the schema's index of the names actions asked for. A variable is
+		// ignored when the command line gave an option its action may not
+		// be given with.
+		bool apply_environment()
+		{
+			auto& index = schema_->env_index_;
+			if (index.empty())
+				return true;
+
+			ARGS_PHASE(dispatch);
+			std::pmr::vector<uint64_t> given { mr_ };
+			if (!schema_->constraints_.empty())
+				given = visited_;
+			for (auto entry = env_ ? env_ : detail::environment(); entry && *entry; ++entry) {
+				std::string_view var { *entry };
+				auto eq = var.find('=');
+				if (eq == std::string_view::npos)
+					continue;
+
+				auto name = var.substr(0, eq);
+				auto value = var.substr(eq + 1);
+				ARGS_COUNT(lookups);
+				auto it = std::lower_bound(index.begin(), index.end(), name, [](const auto& item, std::string_view name) { return item.first < name; });
+				for (; it != index.end() && it->first == name; ++it) {
+					auto id = it->second;
+					if (visited(id) || schema_->excluded(id, given.data()))
+						continue;
+
+					if (schema_->actions_[id]->needs_arg()) {
+						if (!visit(id, value))
+							return false;
+					} else if (!value.empty() && value != "0")
+						visit(id);
+					else
+						continue;
+					mark(id);
+				}
+			}
+			return true;
+		}
+
+		void visit(size_t id)
+		{
+			if (capture_)
+				return capture_->value(id, { });
+			schema_->actions_[id]->visit(*this, target(id));
+		}
+
+		bool visit(size_t id, std::string_view arg)
+		{
+			auto& action = schema_->actions_[id];
+			auto& choices = action->choices();
+			if (choices.empty()) {
+				// capture mode checks the value the same way, without storing it
+				auto valid = capture_ ? action->accepts(arg) : action->visit(*this, target(id), arg);
+				if (!valid)
+					return fail(m_tr(lng::invalid_value, arg_name(id), arg));
+				if (capture_)
+					capture_->value(id, arg);
+				return true;
+			}
+
+			auto choice = choices.find(arg);
+			if (choice == actions::choice_set::npos) {
+				std::pmr::string valid { mr_ };
+				for (auto& name : choices.names()) {
+					if (!valid.empty())
+						valid.append(", ");
+					valid.append("'").append(name).append("'");
+				}
+				return fail(m_tr(lng::invalid_choice, arg_name(id), arg, valid));
+			}
+			if (capture_) {
+				capture_->value(id, arg);
+				return true;
+			}
+			if (!action->visit(*this, target(id), arg, choice))
+				return fail(m_tr(lng::invalid_value, arg_name(id), arg));
+			return true;
+		}
+
+		void mark(size_t id)
+		{
+			ARGS_COUNT(visits);
+			visited_[id / 64] |= uint64_t(1) << (id % 64);
+		}
+
+		bool parse_long(std::string_view name, size_t& i)
+		{
+			if (schema_->provide_help_ && name == "help")
+				return show_help();
+
+			ARGS_COUNT(lookups);
+			auto id = schema_->find(name, comparisons());
+			if (id == schema::npos)
+				return fail(m_tr(lng::unrecognized, detail::expand(mr_, name)));
+
+			auto& action = schema_->actions_[id];
+			if (action->needs_arg()) {
+				++i;
+				if (i >= args_.size())
+					return fail(m_tr(lng::needs_param, detail::expand(mr_, name)));
+
+				if (!visit(id, args_[i]))
+					return false;
+			} else
+				visit(id);
+
+			mark(id);
+			return true;
+		}
+
+		bool parse_short(std::string_view name, size_t& arg)
+		{
+			auto length = name.length();
+			for (decltype(length) i = 0; i < length; ++i) {
+				auto c = name[i];
+				if (schema_->provide_help_ && c == 'h')
+					return show_help();
+
+				ARGS_COUNT(lookups);
+				auto id = schema_->find(c);
+				if (id == schema::npos)
+					return fail(m_tr(lng::unrecognized, detail::expand(mr_, c)));
+
+				auto& action = schema_->actions_[id];
+				if (action->needs_arg()) {
+					std::string_view param;
+
+					++i;
+					if (i < length)
+						param = name.substr(i);
+					else {
+						++arg;
+						if (arg >= args_.size())
+							return fail(m_tr(lng::needs_param, detail::expand(mr_, c)));
+
+						param = args_[arg];
+					}
+
+					i = length;
+
+					if (!visit(id, param))
+						return false;
+				} else
+					visit(id);
+
+				mark(id);
+			}
+			return true;
+		}
+
+		std::pmr::string arg_name(size_t id)
+		{
+			auto& action = schema_->actions_[id];
+			if (action->names().empty())
+				return action->meta_name(m_tr);
+
+			auto& name = action->names().front();
+			std::pmr::string out { mr_ };
+			out.reserve(name.length() + 2);
+			out.append(name.length() == 1 ? "-" : "--").append(name);
+			return out;
+		}
+
+		bool check_constraints()
+		{
+			ARGS_PHASE(required);
+			constexpr auto npos = schema::npos;
+			auto words = schema_->words_;
+			auto visited = visited_.data();
+			auto mask = schema_->masks_.data();
+			auto missing = [](uint64_t mask, uint64_t visited) { return mask & ~visited; };
+			auto present = [](uint64_t mask, uint64_t visited) { return mask & visited; };
+
+			auto id = detail::find_bit(mask, visited, words, 0, missing);
+			if (id != npos)
+				return fail(m_tr(lng::required_arg, arg_name(id)));
+
+			for (auto& rule : schema_->constraints_) {
+				mask += words;
+				if (rule.subject != npos && !this->visited(rule.subject))
+					continue;
+
+				switch (rule.type) {
+				case schema::constraint::exclusive:
+					id = detail::find_bit(mask, visited, words, 0, present);
+					if (id != npos) {
+						auto other = detail::find_bit(mask, visited, words, id + 1, present);
+						if (other != npos)
+							return fail(m_tr(lng::not_allowed_with, arg_name(other), arg_name(id)));
+					}
+					break;
+				case schema::constraint::at_least_one:
+					if (detail::find_bit(mask, visited, words, 0, present) == npos) {
+						std::pmr::string names { mr_ };
+						for (auto member : rule.ids) {
+							if (!names.empty())
+								names.push_back(' ');
+							names.append(arg_name(member));
+						}
+						return fail(m_tr(lng::one_of_required, names));
+					}
+					break;
+				case schema::constraint::depends:
+					id = detail::find_bit(mask, visited, words, 0, missing);
+					if (id != npos)
+						return fail(m_tr(lng::depends_on, arg_name(rule.subject), arg_name(id)));
+					break;
+				case schema::constraint::conflicts:
+					id = detail::find_bit(mask, visited, words, 0, present);
+					if (id != npos)
+						return fail(m_tr(lng::not_allowed_with, arg_name(rule.subject), arg_name(id)));
+					break;
+				}
+			}
+			return true;
+		}
+
+		bool parse_positional(const char* value)
 		{
-			short_help();
+			auto id = schema_->positional_;
+			if (id == schema::npos)
+				return fail(m_tr(lng::unrecognized, value));
 
-			if (!description_.empty()) {
-				fputc('\n', stdout);
-				printer { stdout }.format_paragraph(description_, 0);
+			if (!visit(id, value))
+				return false;
+			mark(id);
+			return true;
+		}
+
+		template <typename output>
+		void short_help(printer_base<output>& out, size_t width)
+		{
+			out.format_paragraph(usage_line(), 7, width);
+		}
+
+		template <typename output>
+		void help(printer_base<output>& out, size_t width)
+		{
+			short_help(out, width);
+
+			auto& description = schema_->description_;
+			if (!description.empty()) {
+				out.putc('\n');
+				out.format_paragraph(description, 0, width);
 			}
 
 			size_t positionals = 0;
 			size_t arguments = 0;
-			std::tie(positionals, arguments) = count_args();
+			std::tie(positionals, arguments) = schema_->count_args();
+			auto& commands = schema_->commands_;
 
-			fmt_list info(positionals ? arguments ? 2 : 1 : arguments ? 1 : 0);
+			fmt_list info { mr_ };
+			info.reserve(3);
 
-			size_t args_id = 0;
 			if (positionals)
-				make_title(info[args_id++], m_tr(lng::positionals), positionals);
+				make_title(info, lng::positionals, positionals);
+
+			if (!commands.empty()) {
+				auto& cmds = make_title(info, lng::commands, commands.size());
+				for (auto& cmd : commands)
+					cmds.items.emplace_back(cmd.name, cmd.help);
+			}
 
+			size_t args_id = info.size();
 			if (arguments) {
-				auto& args = make_title(info[args_id], m_tr(lng::optionals), arguments);
-				if (provide_help_)
-					args.items.push_back(std::make_pair("-h, --help", m_tr(lng::help_description)));
+				auto& args = make_title(info, lng::optionals, arguments);
+				if (schema_->provide_help_)
+					args.items.emplace_back("-h, --help", m_tr(lng::help_description));
 			}
 
-			for (auto& action : actions_) {
-				info[action->names().empty() ? 0 : args_id].items
-					.push_back(std::make_pair(action->help_name(m_tr), action->help()));
+			for (auto& action : schema_->actions_) {
+				auto& items = info[action->names().empty() ? 0 : args_id].items;
+				auto env = action->env();
+				if (env.empty()) {
+					items.emplace_back(action->help_name(m_tr), action->help());
+					continue;
+				}
+
+				std::pmr::string text { action->help(), mr_ };
+				if (!text.empty())
+					text.push_back(' ');
+				text.append(m_tr(lng::env_note, env));
+				items.emplace_back(action->help_name(m_tr), std::move(text));
 			}
 
-			printer { stdout }.format_list(info);
+			out.format_list(info, width);
+		}
+
+		parser& load_command(size_t id)
+		{
+			if (subs_.size() < schema_->commands_.size())
+				subs_.resize(schema_->commands_.size());
+
+			auto& sub = subs_[id];
+			if (!sub) {
+				std::shared_ptr<const schema> def;
+				{
+					ARGS_PHASE(registration);
+					def = schema_->command_schema(id);
+				}
+				sub = detail::pmr_make<parser>(mr_, std::move(def), translator { m_tr }, upstream_);
+#ifdef ARGS_INSTRUMENT
+				sub->report_ = report_;
+#endif
+			}
+			return *sub;
+		}
+
+		bool run_command(size_t i, size_t id)
+		{
+			if (id == schema::npos)
+				return fail(m_tr(lng::unrecognized, args_[i]));
+
+			auto& cmd = schema_->commands_[id];
+			auto& sub = load_command(id);
+			command_ = id;
+			sub.restart_stats();
+			sub.env_ = env_;
+			sub.capture_ = capture_;
+			if (capture_)
+				capture_->command(cmd.name, *sub.schema_);
+
+			std::pmr::string prog { mr_ };
+			prog.reserve(prog_.length() + cmd.name.length() + 1);
+			prog.append(prog_).append(" ").append(cmd.name);
+			if (sub.prog_ != prog)
+				sub.program(prog);
+			sub.args_.assign(args_.begin() + i + 1, args_.end());
+
+			exit_guard guard { sub.exit_, exit_ };
+			if (sub.run())
+				return true;
+			stop_.code = sub.stop_.code;
+			stop_.message = std::move(sub.stop_.message);
+			return false;
+		}
+
+		// words are the ones before cur, without the program name; a command
+		// among them hands the rest over to its own parser
+		void complete(std::string_view cur, const char* const* words, const char* const* end, std::pmr::vector<std::pmr::string>& out)
+		{
+			// the first query scans the schema; only a parser asked again,
+			// e.g. by an embedded shell, pays for the index
+			if (own_ && !own_->indexed_) {
+				if (own_->completed_) {
+					ARGS_PHASE(registration);
+					own_->index();
+				}
+				own_->completed_ = true;
+			}
+
+			auto positional_given = false;
+			for (auto word = words; word != end; ++word) {
+				std::string_view arg = *word ? *word : "";
+				if (arg.length() > 1 && arg[0] == '-') {
+					if (schema_->takes_next(arg) && word + 1 != end)
+						++word;
+					continue;
+				}
+
+				if (schema_->commands_.empty())
+					continue;
+
+				auto id = schema_->complete_command(arg);
+				if (schema_->to_positional(id, positional_given)) {
+					positional_given = true;
+					continue;
+				}
+				if (id != schema::npos)
+					load_command(id).complete(cur, word + 1, end, out);
+				return;
+			}
+
+			std::string_view prev = words != end && end[-1] ? end[-1] : "";
+			schema_->complete(cur, prev, out);
+		}
+
+		bool completing() const
+		{
+			if (!schema_->provide_completion_ || args_.empty() || !args_[0])
+				return false;
+			std::string_view mode { args_[0] };
+			return mode == "--complete" || mode == "--complete-script";
+		}
+
+		bool complete()
+		{
+			std::string_view mode { args_[0] };
+			std::string_view cur = args_.size() > 1 && args_[1] ? args_[1] : "";
+			ARGS_PHASE(rendering);
+			std::pmr::string text { upstream_ };
+
+			if (mode == "--complete") {
+				std::pmr::vector<std::pmr::string> candidates { mr_ };
+				auto words = args_.data() + std::min<size_t>(args_.size(), 2);
+				complete(cur, words, args_.data() + args_.size(), candidates);
+				for (auto& candidate : candidates)
+					text.append(candidate).push_back('\n');
+			} else if (mode == "--complete-script") {
+				if (cur == "bash") text = completion_script(shell::bash);
+				else if (cur == "zsh") text = completion_script(shell::zsh);
+				else if (cur == "fish") text = completion_script(shell::fish);
+				else return fail(m_tr(lng::unrecognized, cur));
+			} else
+				return true;
+
+			if (!exit_) {
+				stop_.code = result::complete;
+				stop_.message = std::move(text);
+				return false;
+			}
 
+			printer { stdout }.print(text.data(), text.length());
+			report();
 			std::exit(0);
 		}
 
-		[[noreturn]] void error(std::string msg)
+		struct exit_guard {
+			bool& exit;
+			bool saved;
+			exit_guard(bool& exit, bool value) : exit(exit), saved(exit) { exit = value; }
+			~exit_guard() { exit = saved; }
+		};
+
+		// Where parsing stops without exiting: the result is kept in
+		// stop_ and false travels back to try_parse()
+		bool fail(std::string_view msg)
 		{
-			short_help(stderr);
-			printer { stderr }.format_paragraph(m_tr(lng::error_msg, prog_, std::move(msg)), 0);
+			if (exit_)
+				error(msg);
+			stop_.code = result::error;
+			stop_.message.assign(msg);
+			return false;
+		}
+
+		bool show_help()
+		{
+			if (exit_)
+				help();
+			stop_.code = result::help;
+			stop_.message.assign(render(true, 0));
+			return false;
+		}
+
+		bool run()
+		{
+#ifdef ARGS_INSTRUMENT
+			report_guard guard { *this };
+#endif
+			auto completing = this->completing();
+			if (own_ && !completing && !own_->compiled_) {
+				ARGS_PHASE(registration);
+				own_->compile();
+			}
+			reset();
+
+			if (completing && !complete())
+				return false;
+
+			auto has_commands = !schema_->commands_.empty();
+			auto command_at = schema::npos;
+			auto command_id = schema::npos;
+
+			auto count = args_.size();
+			{
+				ARGS_PHASE(dispatch);
+				for (decltype(count) i = 0; i < count; ++i) {
+					auto& arg = args_[i];
+					auto length = arg ? strlen(arg) : 0;
+					auto done = true;
+					if (length > 1 && arg[0] == '-') {
+						if (length > 2 && arg[1] == '-')
+							done = parse_long({ arg + 2, length - 2 }, i);
+						else
+							done = parse_short({ arg + 1, length - 1 }, i);
+					} else if (has_commands && arg) {
+						ARGS_COUNT(lookups);
+						command_id = schema_->find_command(arg, comparisons());
+						if (!schema_->to_positional(command_id, visited(schema_->positional_))) {
+							command_at = i;
+							break;
+						}
+						done = parse_positional(arg);
+					} else
+						done = parse_positional(arg ? arg : "");
+					if (!done)
+						return false;
+				}
+			}
+
+			if (!apply_environment() || !check_constraints())
+				return false;
+
+			ARGS_PHASE(dispatch);
+			if (command_at != schema::npos)
+				return run_command(command_at, command_id);
+			if (has_commands)
+				return fail(m_tr(lng::required_arg, m_tr(lng::command_meta)));
+			return true;
+		}
+	public:
+		// Every container, action, rendered help text and message of this
+		// parser (and its schema, when it owns one) comes from mr. With
+		// ARGS_INSTRUMENT, the parser's own containers go through a counter
+		// in front of mr; the schema and returned results never do, so they
+		// may outlive the parser.
+		parser(std::string_view description, translator&& tr = { }, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: upstream_ { mr }, mr_ { counted(mr) }, bindings_(mr_), visited_ { mr_ }, args_ { mr_ }, prog_ { mr_ }, stop_ { result::ok, std::pmr::string { mr } }, m_tr { std::move(tr) }, subs_ { mr_ }, usage_line_ { mr_ }, short_text_ { schema::npos, std::pmr::string { mr_ } }, full_text_ { schema::npos, std::pmr::string { mr_ } }
+		{
+			m_tr.resource(mr_);
+			auto own = std::allocate_shared<schema>(std::pmr::polymorphic_allocator<schema> { upstream_ }, description, upstream_);
+			own_ = own.get();
+			schema_ = std::move(own);
+		}
+
+		parser(std::string_view description, int argc, char* argv[], translator&& tr = { }, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: parser(description, std::move(tr), mr)
+		{
+			bind(argc, argv);
+		}
+
+		// Parses against a schema returned from share(); the schema is never
+		// modified, so any number of such parsers may run concurrently.
+		parser(std::shared_ptr<const schema> shared, translator&& tr = { }, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: upstream_ { mr }, mr_ { counted(mr) }, schema_ { std::move(shared) }, bindings_(mr_), visited_ { mr_ }, args_ { mr_ }, prog_ { mr_ }, stop_ { result::ok, std::pmr::string { mr } }, m_tr { std::move(tr) }, subs_ { mr_ }, usage_line_ { mr_ }, short_text_ { schema::npos, std::pmr::string { mr_ } }, full_text_ { schema::npos, std::pmr::string { mr_ } }
+		{
+			assert(schema_->compiled() && "args::schema must come from parser::share()");
+			m_tr.resource(mr_);
+		}
+
+		parser(std::shared_ptr<const schema> shared, int argc, char* argv[], translator&& tr = { }, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: parser(std::move(shared), std::move(tr), mr)
+		{
+			bind(argc, argv);
+		}
+
+		// Not assignable: the containers would keep allocating from the
+		// target's resource (and, with ARGS_INSTRUMENT, its counter, which
+		// the assignment destroys).
+		parser(const parser&) = delete;
+		parser(parser&&) = default;
+		parser& operator=(const parser&) = delete;
+		parser& operator=(parser&&) = delete;
+
+		template <typename T, typename... Names>
+		actions::builder arg(T& dst, Names&&... names) {
+			ARGS_PHASE(registration);
+			if (auto def = edit())
+				return def->add<actions::store_action<T>>(&dst, std::forward<Names>(names)...);
+			return { nullptr, schema::npos };
+		}
+
+		template <typename Value, typename T, typename... Names>
+		actions::builder set(T& dst, Names&&... names) {
+			ARGS_PHASE(registration);
+			if (auto def = edit())
+				return def->add<actions::value_action<T, Value>>(&dst, std::forward<Names>(names)...);
+			return { nullptr, schema::npos };
+		}
+
+		// The callable is stored in the schema, not the parser. Every parser
+		// built from a shared schema calls the same object, concurrently
+		// when they run on several threads, so a callback used that way
+		// must not mutate unsynchronized state.
+		template <typename Callable, typename... Names>
+		std::enable_if_t<stdex::is_callable_or<Callable,
+			void(),
+			void(parser&),
+			void(const std::string&),
+			void(parser&, const std::string&)
+		>::value, actions::builder> custom(Callable cb, Names&&... names)
+		{
+			ARGS_PHASE(registration);
+			constexpr bool needs_arg = !stdex::is_callable_or_v<Callable&, void(), void(parser&)>;
+			if (auto def = edit())
+				return def->add<actions::custom_action>(static_cast<void*>(nullptr), actions::detail::custom_callback(std::move(cb), def->resource()), needs_arg, std::forward<Names>(names)...);
+			return { nullptr, schema::npos };
+		}
+
+		// Freezes the schema built so far; the returned object is shared by
+		// parsers created from it and this parser cannot register new actions.
+		// Parsers rebind destinations with destination(); custom callbacks
+		// stay shared.
+		std::shared_ptr<const schema> share()
+		{
+			ARGS_PHASE(registration);
+			if (own_ && !own_->compiled_)
+				own_->compile();
+			if (own_)
+				own_->shared_ = true;
+			own_ = nullptr;
+			return schema_;
+		}
+
+		// Writes the action id to dst in this parser only. T must be the
+		// type the action was registered with; custom actions have no
+		// destination to rebind. Returns false, without binding, when the
+		// id or type does not match.
+		template <typename T>
+		bool destination(size_t id, T& dst)
+		{
+			auto& targets = schema_->targets_;
+			assert(id < targets.size() && "args::parser::destination: unknown action id");
+			assert((id >= targets.size() || targets[id].type == detail::type_of<T>()) && "args::parser::destination: T differs from the registered destination");
+			if (id >= targets.size() || targets[id].type != detail::type_of<T>())
+				return false;
+
+			bindings_.reserve(targets.size());
+			while (bindings_.size() < targets.size())
+				bindings_.push_back(targets[bindings_.size()].ptr);
+			bindings_[id] = &dst;
+			return true;
+		}
+
+		void program(std::string_view value)
+		{
+			prog_ = value;
+			invalidate();
+		}
+
+		const std::pmr::string& program() { return prog_; }
+
+		void usage(std::string_view value)
+		{
+			if (auto def = edit())
+				def->usage_ = value;
+		}
+		const std::pmr::string& usage() { return schema_->usage_; }
+
+		void provide_help(bool value = true)
+		{
+			if (auto def = edit())
+				def->provide_help_ = value;
+		}
+
+		// Constraints name actions by builder::id() and are checked after
+		// all arguments are parsed, in the order they were added.
+
+		// At most one of the actions may be given.
+		void exclusive(std::initializer_list<size_t> ids)
+		{
+			if (auto def = edit())
+				def->constrain(schema::constraint::exclusive, schema::npos, ids);
+		}
+
+		// At least one of the actions must be given.
+		void at_least_one(std::initializer_list<size_t> ids)
+		{
+			if (auto def = edit())
+				def->constrain(schema::constraint::at_least_one, schema::npos, ids);
+		}
+
+		// When the action id is given, all of the ids must be given too.
+		void depends(size_t id, std::initializer_list<size_t> ids)
+		{
+			if (auto def = edit())
+				def->constrain(schema::constraint::depends, id, ids);
+		}
+
+		// When the action id is given, none of the ids may be given.
+		void conflicts(size_t id, std::initializer_list<size_t> ids)
+		{
+			if (auto def = edit())
+				def->constrain(schema::constraint::conflicts, id, ids);
+		}
+		bool provide_help() { return schema_->provide_help_; }
+
+		// The factory registers the command's own actions. It runs when the
+		// command is first selected by the first positional argument, once
+		// for this parser and every parser of its shared schema; parsers of
+		// the command are built from what it registered and cannot add to it.
+		// A positional of this parser is filled before the command word, e.g.
+		// "prog in.txt build".
+		template <typename Factory>
+		std::enable_if_t<stdex::is_callable_v<void(parser&), Factory&>> command(std::string_view name, std::string_view help, Factory factory)
+		{
+			ARGS_PHASE(registration);
+			if (auto def = edit())
+				def->add_command(name, help, actions::detail::in_place<command_factory>(std::move(factory), def->resource()));
+		}
+
+		const std::pmr::string& command() const
+		{
+			static const std::pmr::string none;
+			return command_ == schema::npos ? none : schema_->commands_[command_].name;
+		}
+
+		parser* command_parser() { return command_ == schema::npos ? nullptr : subs_[command_].get(); }
+
+		void provide_completion(bool value)
+		{
+			if (auto def = edit())
+				def->provide_completion_ = value;
+		}
+		bool provide_completion() { return schema_->provide_completion_; }
+
+		std::string completion_script(shell sh) const
+		{
+			std::string func { "_args_complete_" };
+			for (auto c : prog_)
+				func.push_back(isalnum(static_cast<unsigned char>(c)) ? c : '_');
+
+			std::string out;
+			switch (sh) {
+			case shell::bash:
+				out.append(func).append("() {\n"
+					"\tlocal IFS=$'\\n'\n"
+					"\tCOMPREPLY=( $(\"${COMP_WORDS[0]}\" --complete \"${COMP_WORDS[COMP_CWORD]}\" \"${COMP_WORDS[@]:1:COMP_CWORD-1}\" 2>/dev/null) )\n"
+					"}\n"
+					"complete -o default -F ").append(func).append(" ").append(prog_).append("\n");
+				break;
+			case shell::zsh:
+				out.append("#compdef ").append(prog_).append("\n")
+					.append(func).append("() {\n"
+					"\tlocal -a candidates\n"
+					"\tcandidates=(\"${(@f)$(\"${words[1]}\" --complete \"${words[CURRENT]}\" \"${(@)words[2,CURRENT-1]}\" 2>/dev/null)}\")\n"
+					// no output splits into one empty line, not into nothing
+					"\tcandidates=(\"${(@)candidates:#}\")\n"
+					"\t(( ${#candidates} )) && compadd -a candidates\n"
+					"}\n"
+					"compdef ").append(func).append(" ").append(prog_).append("\n");
+				break;
+			case shell::fish:
+				out.append("function ").append(func).append("\n"
+					"\tset -l tokens (commandline -opc)\n"
+					"\tset -l words\n"
+					"\tif test (count $tokens) -gt 1\n"
+					"\t\tset words $tokens[2..-1]\n"
+					"\tend\n"
+					"\t$tokens[1] --complete (commandline -ct) $words 2>/dev/null\n"
+					"end\n"
+					"complete -c ").append(prog_).append(" -a '(").append(func).append(")'\n");
+				break;
+			}
+			return out;
+		}
+
+		const std::pmr::vector<const char*>& args() const { return args_; }
+
+		// While set, arguments are handed to the sink instead of their
+		// actions and destinations; checks and errors work as usual.
+		void capture(capture_sink* sink) { capture_ = sink; }
+
+		// Environment block used instead of environ for builder::env()
+		// fallbacks, e.g. main's envp; nullptr restores environ.
+		void environment(const char* const* envp) { env_ = envp; }
+
+#ifdef ARGS_INSTRUMENT
+		const stats& statistics() const { return stats_; }
+
+		// Called with the statistics at the end of every parse, including
+		// the ones ending with help, an error or completion.
+		void instrument(stats_callback cb) { report_ = std::move(cb); }
+#endif
+
+		std::pmr::memory_resource* resource() const { return upstream_; }
+
+		bool visited(size_t id) const
+		{
+			return id / 64 < visited_.size() && (visited_[id / 64] >> (id % 64)) & 1;
+		}
+
+		void reset()
+		{
+			visited_.assign((schema_->actions_.size() + 63) / 64, 0);
+			command_ = schema::npos;
+		}
+
+		void bind(int argc, char* argv[])
+		{
+			restart_stats();
+			ARGS_PHASE(tokenizing);
+			reset();
+			auto prog = argc > 0 ? program_name(argv[0]) : std::string_view { };
+			if (prog != prog_) {
+				prog_ = prog;
+				invalidate();
+			}
+			args_.clear();
+			if (argc > 1)
+				args_.assign(argv + 1, argv + argc);
+		}
+
+		void parse(int argc, char* argv[])
+		{
+			bind(argc, argv);
+			parse();
+		}
+
+		// Returns help, errors and completions instead of exiting. Only
+		// help() and error() called from a custom callback unwind as an
+		// exception, which the C++ runtime allocates outside the parser's
+		// memory resource.
+		result try_parse()
+		{
+			exit_guard guard { exit_, false };
+			try {
+				if (!run())
+					return std::move(stop_);
+			} catch (detail::parse_stop& stop) {
+				return std::move(stop.res);
+			}
+			return { };
+		}
+
+		result try_parse(int argc, char* argv[])
+		{
+			bind(argc, argv);
+			return try_parse();
+		}
+
+		void parse() { run(); }
+
+		// The text help() prints, wrapped for a terminal of the given
+		// width; 0 does not wrap. It stays valid until the schema or the
+		// messages change, or help is rendered for another width.
+		const std::pmr::string& help_text(size_t width = 0)
+		{
+			if (own_ && !own_->compiled_)
+				own_->compile();
+			return render(true, width);
+		}
+
+		// E.g. to invalidate() it after switching the gettext text domain
+		translator& messages() { return m_tr; }
+
+		void short_help(FILE* out = stdout)
+		{
+			printer prn { out };
+			auto& text = render(false, prn.width());
+			prn.print(text.data(), text.length());
+		}
+
+		[[noreturn]] void help()
+		{
+			if (!exit_)
+				throw detail::parse_stop { { result::help, { render(true, 0), upstream_ } } };
+
+			printer prn { stdout };
+			auto& text = render(true, prn.width());
+			prn.print(text.data(), text.length());
+			report();
+			std::exit(0);
+		}
+
+		[[noreturn]] void error(std::string_view msg)
+		{
+			if (!exit_)
+				throw detail::parse_stop { { result::error, std::pmr::string { msg, upstream_ } } };
+
+			printer prn { stderr };
+			auto width = prn.width();
+			std::pmr::string text { render(false, width), mr_ };
+			{
+				ARGS_PHASE(rendering);
+				printer_base<string_printer> { text }.format_paragraph(m_tr(lng::error_msg, prog_, msg), 0, width);
+			}
+			prn.print(text.data(), text.length());
+			report();
 			std::exit(2);
 		}
 	};
+
+	inline std::shared_ptr<const schema> schema::command_schema(size_t id) const
+	{
+		std::lock_guard<std::mutex> lock { commands_lock_ };
+		auto& cmd = commands_[id];
+		if (!cmd.built) {
+			parser def { cmd.help, { }, mr_ };
+			cmd.factory(def);
+			cmd.built = def.share();
+		}
+		return cmd.built;
+	}
 }
+
+#undef ARGS_PHASE
+#undef ARGS_COUNT
@@ -0,0 +1,43 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+// Compile-time cost of parser::custom: registers BENCH_CALLBACKS callbacks,
+// each its own closure type, cycling through the four prototypes custom()
+// accepts. Build bench_compile and compare the compiler's time report.
+
+#include "argsparser.h"
+#include <utility>
+
+#ifndef BENCH_CALLBACKS
+#	define BENCH_CALLBACKS 800
+#endif
+
+namespace {
+	template <size_t I>
+	auto callback(size_t& sink)
+	{
+		if constexpr (I % 4 == 0)
+			return [&sink] { sink += I; };
+		else if constexpr (I % 4 == 1)
+			return [&sink](args::parser&) { sink += I; };
+		else if constexpr (I % 4 == 2)
+			return [&sink](const std::string& value) { sink += I + value.length(); };
+		else
+			return [&sink](args::parser&, const std::string& value) { sink += I + value.length(); };
+	}
+
+	template <size_t... I>
+	void register_all(args::parser& p, size_t& sink, std::index_sequence<I...>)
+	{
+		(p.custom(callback<I>(sink), "option-" + std::to_string(I)).opt(), ...);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t sink = 0;
+	args::parser p { "" };
+	register_all(p, sink, std::make_index_sequence<BENCH_CALLBACKS> { });
+	p.try_parse(argc, argv);
+	return static_cast<int>(sink & 0x7f);
+}
@@ -0,0 +1,282 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+// Registration (with copied and static_text strings), first and repeated
+// completion queries, parse and help rendering of args::parser over
+// synthetic schemas.
+// Usage: bench_parse [max_options [max_tokens]]
+//
+// Built as bench_parse_baseline, with BENCH_BASELINE defined and the
+// headers of the PIECES_BENCH_BASELINE git ref, it prints the registration
+// rows of that release for comparison.
+//
+// rss_kb is how far a phase raised resident memory above where it started.
+// On Linux the kernel's peak is reset before each phase; elsewhere it is
+// the growth of the process-wide peak, which misses phases that stay below
+// an earlier one.
+
+#include <cstring> // the baseline argsparser.h uses it without including
+#include "argsparser.h"
+// global, so allocations outside the parser's memory resource show too
+#define TESTING_COUNT_GLOBAL_NEW
+#include "../tests/counting.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+
+#ifndef _WIN32
+#	include <sys/resource.h>
+#endif
+
+namespace {
+#ifdef __linux__
+	long status_kb(const char* field)
+	{
+		long value = 0;
+		if (auto status = std::fopen("/proc/self/status", "r")) {
+			char line[256];
+			auto length = std::strlen(field);
+			while (std::fgets(line, sizeof(line), status)) {
+				if (!std::strncmp(line, field, length) && line[length] == ':') {
+					value = std::strtol(line + length + 1, nullptr, 10);
+					break;
+				}
+			}
+			std::fclose(status);
+		}
+		return value;
+	}
+#endif
+
+	long peak_rss_kb()
+	{
+#if defined(__linux__)
+		return status_kb("VmHWM");
+#elif defined(_WIN32)
+		return 0;
+#else
+		rusage usage { };
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+#endif
+	}
+
+	// The resident memory a phase starts from
+	long start_rss_kb()
+	{
+#ifdef __linux__
+		if (auto refs = std::fopen("/proc/self/clear_refs", "w")) {
+			std::fputs("5", refs); // resets VmHWM to the current RSS
+			std::fclose(refs);
+		}
+		return status_kb("VmRSS");
+#else
+		return peak_rss_kb();
+#endif
+	}
+
+	template <typename Fn>
+	void measure(const char* phase, size_t options, size_t tokens, const char* workload, Fn&& fn)
+	{
+		auto allocs = testing::global_allocations;
+		auto bytes = testing::global_allocated;
+		auto rss = start_rss_kb();
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+		std::printf("%-12s %8zu %8zu %-10s %12.3f %10zu %12zu %10ld\n",
+			phase, options, tokens, workload, time.count(), testing::global_allocations - allocs, testing::global_allocated - bytes, peak_rss_kb() - rss);
+	}
+
+	// Names and help of the synthetic options, built before registration
+	// and kept until exit, so a schema may borrow them as static_text
+	struct text_table {
+		std::vector<std::string> names;
+		std::vector<std::string> help;
+		std::array<std::string, 26> flags;
+
+		explicit text_table(size_t options)
+		{
+			names.reserve(options);
+			help.reserve(options);
+			for (size_t id = 0; id < options; ++id) {
+				names.push_back("option-" + std::to_string(id));
+				help.push_back("Value of the synthetic option number " + std::to_string(id) + ", described with enough words to wrap on a narrow terminal.");
+			}
+			for (size_t id = 0; id < flags.size(); ++id)
+				flags[id].assign(1, char('A' + id));
+		}
+	};
+
+#ifdef BENCH_BASELINE
+	struct schema {
+		std::vector<std::string> values;
+		std::array<bool, 26> flags { };
+		std::vector<std::string> files;
+		char program[6] = "bench";
+		char* argv[2] = { program, nullptr };
+		args::parser parser { "Synthetic schema for measuring registration, parse and help rendering.", 1, argv };
+
+		explicit schema(const text_table& table) : values(table.names.size())
+		{
+			for (size_t id = 0; id < values.size(); ++id)
+				parser.arg(values[id], table.names[id]).opt().meta("VALUE").help(table.help[id]);
+			for (size_t id = 0; id < flags.size(); ++id)
+				parser.set<std::true_type>(flags[id], table.flags[id]).opt().help("A short flag.");
+			parser.arg(files).opt().meta("FILE").help("Positional arguments.");
+		}
+	};
+#else
+	struct schema {
+		std::vector<std::string> values;
+		std::array<bool, 26> flags { };
+		std::vector<std::string> files;
+		args::parser parser { "Synthetic schema for measuring registration, parse and help rendering." };
+
+		schema(const text_table& table, bool borrow) : values(table.names.size())
+		{
+			auto text = [borrow](std::string_view view) -> args::str_ref {
+				if (borrow)
+					return args::static_text { view };
+				return view;
+			};
+
+			for (size_t id = 0; id < values.size(); ++id)
+				parser.arg(values[id], text(table.names[id])).opt().meta(text("VALUE")).help(text(table.help[id]));
+			for (size_t id = 0; id < flags.size(); ++id)
+				parser.set<std::true_type>(flags[id], text(table.flags[id])).opt().help(text("A short flag."));
+			parser.arg(files).opt().meta(text("FILE")).help(text("Positional arguments."));
+		}
+	};
+
+	enum workload {
+		long_opts,
+		short_opts,
+		clustered,
+		positional
+	};
+
+	const char* const workload_names[] = { "long", "short", "clustered", "positional" };
+
+	std::vector<std::string> make_tokens(workload kind, size_t options, size_t count)
+	{
+		std::vector<std::string> out;
+		out.reserve(count + 1);
+		out.emplace_back("bench");
+		for (size_t index = 0; out.size() <= count; ++index) {
+			switch (kind) {
+			case long_opts:
+				out.push_back("--option-" + std::to_string(index % options));
+				out.push_back("value");
+				break;
+			case short_opts:
+				out.push_back({ '-', char('A' + index % 26) });
+				break;
+			case clustered:
+				out.emplace_back("-ABCDEFGH");
+				break;
+			case positional:
+				out.push_back("file-" + std::to_string(index));
+				break;
+			}
+		}
+		out.resize(count + 1);
+		return out;
+	}
+
+	template <typename Tokens>
+	std::vector<char*> make_argv(Tokens& tokens)
+	{
+		std::vector<char*> argv;
+		argv.reserve(std::size(tokens));
+		for (auto& token : tokens)
+			argv.push_back(token.data());
+		return argv;
+	}
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	size_t max_options = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+	size_t max_tokens = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+
+	auto null = std::fopen(
+#ifdef _WIN32
+		"NUL",
+#else
+		"/dev/null",
+#endif
+		"w");
+	if (!null)
+		return 1;
+
+	std::printf("%-12s %8s %8s %-10s %12s %10s %12s %10s\n", "phase", "options", "tokens", "workload", "time_ms", "allocs", "bytes", "rss_kb");
+	for (size_t options = 10; options <= max_options; options *= 10) {
+		text_table table { options };
+#ifdef BENCH_BASELINE
+		std::unique_ptr<schema> def;
+		measure("registration", options, 0, "baseline", [&] { def = std::make_unique<schema>(table); });
+		static_cast<void>(max_tokens);
+#else
+		std::unique_ptr<schema> def;
+		measure("registration", options, 0, "copied", [&] { def = std::make_unique<schema>(table, false); });
+		def->parser.share();
+		std::unique_ptr<schema> borrowed;
+		measure("registration", options, 0, "static", [&] { borrowed = std::make_unique<schema>(table, true); });
+
+		// what a shell pays for one TAB: a fresh process registers the
+		// schema, then answers a single query
+		borrowed->parser.provide_completion(true);
+		std::string complete[] = { "bench", "--complete", "--option-1" };
+		auto complete_args = make_argv(complete);
+		measure("complete", options, 1, "first", [&] {
+			borrowed->parser.try_parse(static_cast<int>(complete_args.size()), complete_args.data());
+		});
+		// an embedded shell asking again: the second query indexes the
+		// schema, later ones look names up in the index
+		borrowed->parser.try_parse(static_cast<int>(complete_args.size()), complete_args.data());
+		measure("complete", options, 1, "repeated", [&] {
+			borrowed->parser.try_parse(static_cast<int>(complete_args.size()), complete_args.data());
+		});
+		borrowed.reset();
+
+		for (size_t tokens : { 10, 1000, 100000, 1000000 }) {
+			if (tokens > max_tokens)
+				break;
+			for (auto kind : { long_opts, short_opts, clustered, positional }) {
+				auto words = make_tokens(kind, options, tokens);
+				auto args = make_argv(words);
+				def->files.reserve(tokens);
+				args::result res;
+				measure("parse", options, tokens, workload_names[kind], [&] {
+					res = def->parser.try_parse(static_cast<int>(args.size()), args.data());
+				});
+				if (!res) {
+					std::fprintf(stderr, "parse failed: %s\n", res.message.c_str());
+					return 1;
+				}
+				def->files.clear();
+			}
+		}
+
+		// many short command lines through one parser, as an embedded
+		// shell would issue them
+		constexpr size_t lines = 10000;
+		auto words = make_tokens(long_opts, options, 10);
+		auto args = make_argv(words);
+		measure("lines", options, 10 * lines, "long", [&] {
+			for (size_t line = 0; line < lines; ++line)
+				def->parser.try_parse(static_cast<int>(args.size()), args.data());
+		});
+
+		measure("help", options, 0, "width 80", [&] {
+			def->parser.program("bench");
+			auto& text = def->parser.help_text(80);
+			std::fwrite(text.data(), 1, text.length(), null);
+		});
+#endif
+	}
+
+	std::fclose(null);
+}
@@ -0,0 +1,52 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+// Compile-time cost of stdex::is_callable_or alone: checks BENCH_CALLBACKS
+// closure types, each its own type, against the four prototypes
+// parser::custom accepts. Build bench_compile and compare the compiler's
+// time report with the one for the first release's callable.h.
+
+#include "callable.h"
+#include <string>
+#include <utility>
+
+#ifndef BENCH_CALLBACKS
+#	define BENCH_CALLBACKS 800
+#endif
+
+namespace {
+	struct parser { };
+
+	template <size_t I>
+	auto callback(size_t& sink)
+	{
+		if constexpr (I % 4 == 0)
+			return [&sink] { sink += I; };
+		else if constexpr (I % 4 == 1)
+			return [&sink](parser&) { sink += I; };
+		else if constexpr (I % 4 == 2)
+			return [&sink](const std::string& value) { sink += I + value.length(); };
+		else
+			return [&sink](parser&, const std::string& value) { sink += I + value.length(); };
+	}
+
+	template <size_t I>
+	constexpr bool accepted = stdex::is_callable_or<decltype(callback<I>(std::declval<size_t&>())),
+		void(),
+		void(parser&),
+		void(const std::string&),
+		void(parser&, const std::string&)
+	>::value;
+
+	template <size_t... I>
+	constexpr size_t count_accepted(std::index_sequence<I...>)
+	{
+		return (size_t { accepted<I> } + ... + 0);
+	}
+}
+
+static_assert(count_accepted(std::make_index_sequence<BENCH_CALLBACKS> { }) == BENCH_CALLBACKS, "every callback has an accepted prototype");
+
+int main()
+{
+}
@@ -2,60 +2,200 @@
 // This code is licensed under MIT license (see LICENSE for details)
 
 #pragma once
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
 #include <type_traits>
+#include <utility>
+
+#if defined(__cpp_concepts) && __cpp_concepts >= 201907L
+#	define STDEX_HAS_CONCEPTS
+#endif
 
 namespace stdex {
 	template <typename Prototype, typename Callable> struct is_callable : std::false_type {
 	};
 
-	template <typename Return, typename... Args, typename Callable>
-	struct is_callable<Return(Args...), Callable> {
-	private:
-		typedef char(&yes)[1];
-		typedef char(&no)[2];
+#ifdef STDEX_HAS_CONCEPTS
+	template <typename Callable, typename Return, typename... Args>
+	concept callable_with = requires {
+		std::declval<Callable>()(std::declval<Args>()...);
+	} && (std::is_void_v<Return> || std::is_convertible_v<decltype(std::declval<Callable>()(std::declval<Args>()...)), Return>);
 
-		template <typename C, typename... A>
-		using result_of = decltype(std::declval<C>()(std::declval<A>()...));
+	template <typename Return, typename... Args, typename Callable>
+	struct is_callable<Return(Args...), Callable> : std::bool_constant<callable_with<Callable, Return, Args...>> {
+	};
+#else
+	namespace detail {
+		template <typename Callable, typename... Args>
+		using call_result = decltype(std::declval<Callable>()(std::declval<Args>()...));
 
-		template<typename C> static yes test(result_of<C, Args...>*);
-		template<typename C> static no  test(...);
+		template <typename Void, typename Callable, typename Return, typename... Args>
+		struct callable_with : std::false_type {
+		};
 
-		template<bool HasArgs, typename C, typename R, typename... A> struct return_helper:
-			std::is_convertible<result_of<C, A...>, R> { };
-		template<typename C, typename... A> struct return_helper<true, C, void, A...> : std::true_type { };
-		template<typename C, typename R, typename... A> struct return_helper<false, C, R, A...> : std::false_type { };
+		template <typename Callable, typename Return, typename... Args>
+		struct callable_with<std::void_t<call_result<Callable, Args...>>, Callable, Return, Args...>
+			: std::bool_constant<std::is_void<Return>::value || std::is_convertible<call_result<Callable, Args...>, Return>::value> {
+		};
+	}
 
-		static constexpr bool value_args = sizeof(test<Callable>(nullptr)) == sizeof(yes);
-		static constexpr bool value_return = return_helper<value_args, Callable, Return, Args...>::value;
-	public:
-		static constexpr bool value = value_args && value_return;
+	template <typename Return, typename... Args, typename Callable>
+	struct is_callable<Return(Args...), Callable> : detail::callable_with<void, Callable, Return, Args...> {
 	};
+#endif
 
-	template<typename... B>
-	struct or_;
-
-	template<>
-	struct or_<> : std::false_type {
+	template <typename... B>
+	struct or_ : std::disjunction<B...> {
 	};
 
-	template<typename B>
-	struct or_<B> : B {
+	// std::disjunction stops instantiating at the first match
+	template <typename Callable, typename... Prototypes>
+	struct is_callable_or : std::disjunction<is_callable<Prototypes, Callable>...> {
 	};
 
-	template <bool Value, typename Head, typename... Tail>
-	struct select_or_ : Head {
-	};
+	template <typename Prototype, typename Callable>
+	inline constexpr bool is_callable_v = is_callable<Prototype, Callable>::value;
 
-	template <typename Head, typename... Tail>
-	struct select_or_<false, Head, Tail...> : or_<Tail...> {
-	};
+	template <typename Callable, typename... Prototypes>
+	inline constexpr bool is_callable_or_v = is_callable_or<Callable, Prototypes...>::value;
 
-	template<typename Head, typename... Tail>
-	struct or_<Head, Tail...> : select_or_<Head::value, Head, Tail...> {
-	};
+#ifdef STDEX_HAS_CONCEPTS
+	template <typename Callable, typename Prototype>
+	concept callable = is_callable_v<Prototype, Callable>;
 
 	template <typename Callable, typename... Prototypes>
-	struct is_callable_or : or_<is_callable<Prototypes, Callable>...> {
+	concept callable_or = (is_callable_v<Prototypes, Callable> || ...);
+#endif
+
+	template <typename Signature, size_t Capacity = 4 * sizeof(void*)>
+	class inplace_function;
+
+	// Move-only std::function without the heap: the target lives in Capacity
+	// bytes inside the object and a callable that does not fit, or may throw
+	// when moved, fails to compile. Calling an empty inplace_function is
+	// undefined, as with a null function pointer; debug builds assert.
+	template <typename Return, typename... Args, size_t Capacity>
+	class inplace_function<Return(Args...), Capacity> {
+		struct ops {
+			Return (*invoke)(void*, Args&&...);
+			void (*move)(void*, void*);
+			void (*destroy)(void*);
+		};
+
+		template <typename Target>
+		struct model {
+			static Return invoke(void* self, Args&&... args)
+			{
+				if constexpr (std::is_void<Return>::value)
+					(*static_cast<Target*>(self))(std::forward<Args>(args)...);
+				else
+					return (*static_cast<Target*>(self))(std::forward<Args>(args)...);
+			}
+			static void move(void* dst, void* src)
+			{
+				new (dst) Target(std::move(*static_cast<Target*>(src)));
+				static_cast<Target*>(src)->~Target();
+			}
+			static void destroy(void* self) { static_cast<Target*>(self)->~Target(); }
+
+			static constexpr ops table { invoke, move, destroy };
+		};
+
+		template <typename F>
+		using enable_target = std::enable_if_t<
+			!std::is_same<std::decay_t<F>, inplace_function>::value &&
+			is_callable<Return(Args...), std::decay_t<F>&>::value>;
+
+		alignas(std::max_align_t) unsigned char buffer_[Capacity];
+		const ops* ops_ = nullptr;
+	public:
+		inplace_function() noexcept = default;
+		inplace_function(std::nullptr_t) noexcept {}
+
+		template <typename F, typename = enable_target<F>>
+		inplace_function(F&& target)
+		{
+			using Target = std::decay_t<F>;
+			static_assert(sizeof(Target) <= Capacity, "callable does not fit stdex::inplace_function; raise the capacity");
+			static_assert(alignof(Target) <= alignof(std::max_align_t), "callable is over-aligned for stdex::inplace_function");
+			static_assert(std::is_nothrow_move_constructible<Target>::value, "callable may throw on move, which stdex::inplace_function cannot");
+			new (buffer_) Target(std::forward<F>(target));
+			ops_ = &model<Target>::table;
+		}
+
+		inplace_function(inplace_function&& other) noexcept : ops_ { other.ops_ }
+		{
+			if (ops_)
+				ops_->move(buffer_, other.buffer_);
+			other.ops_ = nullptr;
+		}
+
+		~inplace_function()
+		{
+			if (ops_)
+				ops_->destroy(buffer_);
+		}
+
+		inplace_function& operator=(inplace_function&& other) noexcept
+		{
+			if (this != &other) {
+				this->~inplace_function();
+				new (this) inplace_function(std::move(other));
+			}
+			return *this;
+		}
+
+		explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+		Return operator()(Args... args) const
+		{
+			assert(ops_ && "empty stdex::inplace_function called");
+			return ops_->invoke(const_cast<unsigned char*>(buffer_), std::forward<Args>(args)...);
+		}
 	};
-}
 
+	template <typename Signature>
+	class function_ref;
+
+	// Non-owning reference to a callable; it must outlive the reference.
+	template <typename Return, typename... Args>
+	class function_ref<Return(Args...)> {
+		union target {
+			void* object;
+			void (*function)();
+		};
+
+		target target_;
+		Return (*invoke_)(target, Args&&...);
+
+		template <typename F>
+		using enable_target = std::enable_if_t<
+			!std::is_same<std::decay_t<F>, function_ref>::value &&
+			is_callable<Return(Args...), F&>::value>;
+	public:
+		template <typename F, typename = enable_target<F>>
+		function_ref(F&& callable) noexcept
+		{
+			using Pointer = std::add_pointer_t<std::remove_reference_t<F>>;
+			if constexpr (std::is_function<std::remove_reference_t<F>>::value || std::is_function<std::remove_pointer_t<std::decay_t<F>>>::value) {
+				target_.function = reinterpret_cast<void (*)()>(+callable);
+				invoke_ = [](target self, Args&&... args) -> Return {
+					using Function = std::decay_t<F>;
+					return reinterpret_cast<Function>(self.function)(std::forward<Args>(args)...);
+				};
+			} else {
+				target_.object = const_cast<void*>(static_cast<const volatile void*>(std::addressof(callable)));
+				invoke_ = [](target self, Args&&... args) -> Return {
+					return (*static_cast<Pointer>(self.object))(std::forward<Args>(args)...);
+				};
+			}
+		}
+
+		Return operator()(Args... args) const
+		{
+			return invoke_(target_, std::forward<Args>(args)...);
+		}
+	};
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+// A parser over a memory resource must not fall back to the global
+// allocator; this file replaces operator new, through counting.h, to
+// count what does. The C++ runtime allocates exceptions with malloc, out
+// of its sight, so help and errors must come back from try_parse()
+// without one.
+
+#define TESTING_COUNT_GLOBAL_NEW
+#include "argsparser.h"
+#include "counting.h"
+#include "testing.h"
+
+TEST(parses_without_global_allocations)
+{
+	static char buffer[1 << 20];
+	std::pmr::monotonic_buffer_resource mr { buffer, sizeof(buffer), std::pmr::null_memory_resource() };
+
+	const char* const no_env[] = { nullptr };
+	int jobs = 0;
+	std::string_view target;
+	bool verbose = false;
+	testing::argv ok { "prog", "-v", "build", "-j", "4", "--target", "all" };
+	testing::argv error { "prog", "--unknown" };
+	testing::argv help { "prog", "--help" };
+	testing::argv invalid { "prog", "build", "-j", "many" };
+	testing::argv clean { "prog", "clean" };
+	testing::argv build_help { "prog", "build", "-h" };
+	testing::argv no_command { "prog", "-v" };
+
+	auto before = testing::global_allocations;
+	{
+		args::parser p { "Builds things.", { }, &mr };
+		p.environment(no_env);
+		p.set<std::true_type>(verbose, "v").opt();
+		p.command("build", "build things", [&](args::parser& sub) {
+			sub.arg(jobs, "j").opt();
+			sub.arg(target, "target").opt().env("TARGET");
+		});
+		p.command("clean", "remove things", [](args::parser&) { });
+
+		for (auto round = 0; round < 2; ++round) {
+			CHECK(p.try_parse(ok.argc(), ok.data()));
+			CHECK_EQ(p.try_parse(error.argc(), error.data()).code, args::result::error);
+			CHECK_EQ(p.try_parse(help.argc(), help.data()).code, args::result::help);
+			CHECK_EQ(p.try_parse(invalid.argc(), invalid.data()).code, args::result::error);
+			CHECK(p.try_parse(clean.argc(), clean.data()));
+			CHECK_EQ(p.try_parse(build_help.argc(), build_help.data()).code, args::result::help);
+			CHECK_EQ(p.try_parse(no_command.argc(), no_command.data()).code, args::result::error);
+		}
+	}
+	auto allocations = testing::global_allocations - before;
+	CHECK_EQ(allocations, 0u);
+	CHECK_EQ(jobs, 4);
+	CHECK_EQ(target, "all");
+}
+
+TEST(stores_factories_and_completers_without_global_allocations)
+{
+	static char buffer[1 << 20];
+	std::pmr::monotonic_buffer_resource mr { buffer, sizeof(buffer), std::pmr::null_memory_resource() };
+
+	// both captures are too big to be stored in place
+	std::array<char, 4 * ARGS_CUSTOM_CAPACITY> suffix { };
+	std::memcpy(suffix.data(), "-debug", 7);
+	std::string_view level;
+	int built = 0;
+	testing::argv build { "prog", "build" };
+	testing::argv tab { "prog", "--complete", "x", "build", "--level" };
+
+	auto before = testing::global_allocations;
+	{
+		args::parser p { "", { }, &mr };
+		p.provide_completion(true);
+		p.command("build", "build things", [&, suffix](args::parser& sub) {
+			++built;
+			sub.arg(level, "level").opt().complete([suffix](std::string_view prefix, std::pmr::vector<std::pmr::string>& out) {
+				out.emplace_back(prefix).append(suffix.data());
+			});
+		});
+
+		for (auto round = 0; round < 2; ++round) {
+			CHECK(p.try_parse(build.argc(), build.data()));
+			auto res = p.try_parse(tab.argc(), tab.data());
+			CHECK_EQ(res.code, args::result::complete);
+			CHECK_EQ(res.message, "x-debug\n");
+		}
+	}
+	auto allocations = testing::global_allocations - before;
+	CHECK_EQ(allocations, 0u);
+	CHECK_EQ(built, 1);
+}
@@ -0,0 +1,237 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "argsbulk.h"
+#include "testing.h"
+#include <atomic>
+
+namespace {
+	std::vector<std::string> split(std::string_view line)
+	{
+		std::pmr::string storage;
+		std::pmr::vector<char*> argv;
+		args::detail::tokenize(line, storage, argv);
+		return { argv.begin(), argv.end() };
+	}
+
+	struct tool {
+		int count = 0;
+		std::string name;
+		std::vector<std::string> files;
+		size_t count_id, name_id, files_id;
+		std::shared_ptr<const args::schema> schema;
+
+		tool()
+		{
+			args::parser p { "" };
+			count_id = p.arg(count, "c", "count").opt().id();
+			name_id = p.arg(name, "name").opt().id();
+			files_id = p.arg(files, "f").opt().id();
+			schema = p.share();
+		}
+	};
+}
+
+TEST(tokenizer_honours_quotes_and_escapes)
+{
+	CHECK(split("") == std::vector<std::string> { });
+	CHECK(split("  prog \t a  b ") == (std::vector<std::string> { "prog", "a", "b" }));
+	CHECK(split("'a b' 'it''s' '\\n'") == (std::vector<std::string> { "a b", "its", "\\n" }));
+	CHECK(split(R"("a \"b\" \\ \$ \` \n")") == (std::vector<std::string> { R"(a "b" \ $ ` \n)" }));
+	CHECK(split(R"(a\ b \'c \\)") == (std::vector<std::string> { "a b", "'c", "\\" }));
+	CHECK(split("x'y'\"z\" '' \"\"") == (std::vector<std::string> { "xyz", "", "" }));
+	CHECK(split("'open \"unterminated") == (std::vector<std::string> { "open \"unterminated" }));
+}
+
+TEST(collects_values_status_and_messages)
+{
+	tool t;
+	args::bulk bulk { t.schema, 1 };
+	auto out = bulk.parse(
+		"prog --count 3 --name 'a b' -f x -fy\n"
+		"prog --count abc\n"
+		"prog --name dropped --other -f x\n"
+		"prog --count 2 --count 1\n"
+		"prog\n");
+
+	CHECK_EQ(out.rows, 5u);
+	CHECK_EQ(out.status.size(), 5u);
+	CHECK_EQ(out.status[0], args::result::ok);
+	CHECK_EQ(out.columns[t.count_id].value(0), "3");
+	CHECK_EQ(out.columns[t.name_id].value(0), "a b");
+	CHECK_EQ(out.columns[t.files_id].count(0), 2u);
+	CHECK_EQ(out.columns[t.files_id].value(0, 1), "y");
+	CHECK_EQ(out.message[0], "");
+
+	CHECK_EQ(out.status[1], args::result::error);
+	CHECK_EQ(out.message[1], "argument -c: invalid value: 'abc'");
+	CHECK(!out.columns[t.count_id].present(1));
+
+	CHECK_EQ(out.status[2], args::result::error);
+	CHECK_EQ(out.message[2], "unrecognized argument: --other");
+	CHECK(!out.columns[t.name_id].present(2));
+
+	CHECK_EQ(out.status[3], args::result::ok);
+	CHECK_EQ(out.columns[t.count_id].count(3), 2u);
+	CHECK_EQ(out.columns[t.count_id].value(3, 1), "1");
+
+	CHECK_EQ(out.status[4], args::result::ok);
+	CHECK(!out.columns[t.count_id].present(4));
+	CHECK_EQ(t.count, 0);
+}
+
+TEST(records_the_selected_command)
+{
+	std::string jobs;
+	args::parser p { "" };
+	p.command("build", "build things", [&](args::parser& sub) { sub.arg(jobs, "j").opt(); });
+	p.command("clean", "remove things", [](args::parser&) { });
+	args::bulk bulk { p.share(), 1 };
+
+	auto out = bulk.parse("prog build -j 2\nprog clean\nprog\nprog build --bad\n");
+	CHECK_EQ(out.rows, 4u);
+	CHECK_EQ(out.command[0], "build");
+	CHECK_EQ(out.status[0], args::result::ok);
+	CHECK_EQ(out.command[1], "clean");
+	CHECK_EQ(out.status[2], args::result::error);
+	CHECK_EQ(out.message[2], "argument COMMAND is required");
+	CHECK_EQ(out.command[3], "build");
+	CHECK_EQ(out.message[3], "unrecognized argument: --bad");
+	CHECK_EQ(jobs, "");
+}
+
+TEST(builds_each_command_once_for_all_workers)
+{
+	std::atomic<int> builds { 0 };
+	std::string jobs;
+	args::parser p { "" };
+	p.command("build", "build things", [&](args::parser& sub) {
+		++builds;
+		sub.arg(jobs, "j").opt();
+	});
+	p.command("clean", "remove things", [&](args::parser&) { ++builds; });
+	args::bulk bulk { p.share(), 4 };
+
+	std::vector<std::string_view> lines;
+	for (size_t row = 0; row < 5000; ++row)
+		lines.push_back(row % 2 ? "prog clean" : "prog build -j 2");
+	auto out = bulk.parse(lines);
+	CHECK_EQ(out.rows, lines.size());
+	CHECK_EQ(std::count(out.status.begin(), out.status.end(), args::result::ok), 5000);
+	CHECK_EQ(builds.load(), 2);
+}
+
+TEST(keeps_command_values_in_their_own_columns)
+{
+	std::string remote, name, url, jobs;
+	size_t name_id = 0, url_id = 0, jobs_id = 0;
+	args::parser p { "" };
+	auto remote_id = p.arg(remote, "remote").opt().id();
+	p.command("remote", "manage remotes", [&](args::parser& sub) {
+		sub.command("add", "add a remote", [&](args::parser& add) {
+			name_id = add.arg(name, "name").id();
+			url_id = add.arg(url, "url").opt().id();
+		});
+	});
+	p.command("build", "build things", [&](args::parser& sub) { jobs_id = sub.arg(jobs, "j").opt().id(); });
+	args::bulk bulk { p.share(), 1 };
+
+	auto out = bulk.parse(
+		"prog build -j 2\n"
+		"prog --remote origin remote add --name x --url y\n"
+		"prog remote add --url y\n"
+		"prog build\n");
+	CHECK_EQ(out.columns.size(), 1u);
+	CHECK_EQ(out.status[1], args::result::ok);
+	CHECK_EQ(out.command[1], "remote add");
+	CHECK_EQ(out.columns[remote_id].value(1), "origin");
+
+	auto& add = out.command_columns["remote add"];
+	CHECK_EQ(add.size(), 2u);
+	CHECK(!add[name_id].present(0));
+	CHECK_EQ(add[name_id].value(1), "x");
+	CHECK_EQ(add[url_id].value(1), "y");
+	CHECK(!add[url_id].present(3));
+
+	// a row that fails keeps no command values either
+	CHECK_EQ(out.status[2], args::result::error);
+	CHECK_EQ(out.message[2], "argument --name is required");
+	CHECK(!add[url_id].present(2));
+
+	auto& build = out.command_columns["build"];
+	CHECK_EQ(build[jobs_id].value(0), "2");
+	CHECK(!build[jobs_id].present(1));
+	CHECK(!build[jobs_id].present(3));
+	CHECK(out.command_columns["remote"].empty());
+	CHECK_EQ(name, "");
+	CHECK_EQ(jobs, "");
+}
+
+TEST(merges_command_columns_from_every_worker)
+{
+	std::string jobs;
+	size_t jobs_id = 0;
+	args::parser p { "" };
+	p.command("build", "build things", [&](args::parser& sub) { jobs_id = sub.arg(jobs, "j").opt().id(); });
+	p.command("clean", "remove things", [](args::parser&) { });
+	args::bulk bulk { p.share(), 4 };
+
+	// build shows up only in the last part
+	constexpr size_t rows = 5000;
+	std::vector<std::string> text;
+	for (size_t row = 0; row < rows; ++row)
+		text.push_back(row < 4000 ? "prog clean" : "prog build -j " + std::to_string(row));
+	std::vector<std::string_view> lines { text.begin(), text.end() };
+
+	auto out = bulk.parse(lines);
+	auto& col = out.command_columns["build"][jobs_id];
+	size_t mismatches = 0;
+	for (size_t row = 0; row < rows; ++row) {
+		auto ok = row < 4000 ? !col.present(row) : col.count(row) == 1 && col.value(row) == std::to_string(row);
+		if (!ok)
+			++mismatches;
+	}
+	CHECK_EQ(mismatches, 0u);
+}
+
+TEST(merges_columns_from_every_worker)
+{
+	tool t;
+	constexpr size_t rows = 5000;
+	std::vector<std::string> text;
+	for (size_t row = 0; row < rows; ++row) {
+		auto line = std::string { "prog --count " } + std::to_string(row);
+		for (size_t file = 0; file < row % 3; ++file)
+			line.append(" -f f").append(std::to_string(row));
+		if (row % 7 == 0)
+			line.append(" --count x");
+		text.push_back(line);
+	}
+	std::vector<std::string_view> lines { text.begin(), text.end() };
+
+	auto single = args::bulk { t.schema, 1 }.parse(lines);
+	auto out = args::bulk { t.schema, 4 }.parse(lines);
+	CHECK_EQ(out.rows, rows);
+	CHECK_EQ(out.status.size(), rows);
+	CHECK_EQ(out.message.size(), rows);
+	CHECK_EQ(out.command.size(), rows);
+
+	size_t mismatches = 0;
+	for (size_t row = 0; row < rows; ++row) {
+		auto& count = out.columns[t.count_id];
+		auto& files = out.columns[t.files_id];
+		auto ok = out.status[row] == (row % 7 ? args::result::ok : args::result::error)
+			&& out.status[row] == single.status[row]
+			&& out.message[row] == single.message[row]
+			&& files.count(row) == single.columns[t.files_id].count(row);
+		if (row % 7 == 0)
+			ok = ok && !count.present(row) && !files.present(row);
+		else
+			ok = ok && count.count(row) == 1 && count.value(row) == std::to_string(row) && files.count(row) == row % 3;
+		for (size_t file = 0; ok && file < files.count(row); ++file)
+			ok = files.value(row, file) == "f" + std::to_string(row);
+		if (!ok)
+			++mismatches;
+	}
+	CHECK_EQ(mismatches, 0u);
+}
@@ -0,0 +1,192 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+// Built as C++17 (void_t) and C++20 (concepts): both implementations of
+// stdex::is_callable must agree with the first release on every pair of
+// callable and prototype below. The tests after the matrix cover
+// stdex::inplace_function and stdex::function_ref.
+
+#include "callable.h"
+#include "testing.h"
+#include <memory>
+#include <string>
+
+namespace {
+	struct parser { };
+
+	// one bit per prototype
+	enum : unsigned {
+		void_ = 1 << 0,             // void()
+		with_parser = 1 << 1,       // void(parser&)
+		with_value = 1 << 2,        // void(const std::string&)
+		with_both = 1 << 3,         // void(parser&, const std::string&)
+		returning_int = 1 << 4,     // int()
+		returning_bool = 1 << 5,    // bool(const std::string&)
+		with_int = 1 << 6,          // void(int)
+		custom_prototypes = void_ | with_parser | with_value | with_both
+	};
+
+	template <typename Callable>
+	constexpr unsigned accepted =
+		(stdex::is_callable_v<void(), Callable> ? void_ : 0) |
+		(stdex::is_callable_v<void(parser&), Callable> ? with_parser : 0) |
+		(stdex::is_callable_v<void(const std::string&), Callable> ? with_value : 0) |
+		(stdex::is_callable_v<void(parser&, const std::string&), Callable> ? with_both : 0) |
+		(stdex::is_callable_v<int(), Callable> ? returning_int : 0) |
+		(stdex::is_callable_v<bool(const std::string&), Callable> ? returning_bool : 0) |
+		(stdex::is_callable_v<void(int), Callable> ? with_int : 0);
+
+	template <typename Callable>
+	constexpr bool custom = stdex::is_callable_or_v<Callable,
+		void(),
+		void(parser&),
+		void(const std::string&),
+		void(parser&, const std::string&)>;
+
+	constexpr auto no_args = [] { };
+	constexpr auto parser_only = [](parser&) { };
+	constexpr auto value_only = [](const std::string&) { };
+	constexpr auto both = [](parser&, const std::string&) { };
+	constexpr auto returns_int = [] { return 1; };
+	constexpr auto value_copy = [](std::string) { };
+	constexpr auto generic = [](auto&&...) { };
+	constexpr auto value_ref = [](std::string&) { };
+	constexpr auto int_only = [](int) { };
+	constexpr auto returns_text = [](const std::string&) { return ""; };
+
+	struct overloaded {
+		void operator()() const { }
+		void operator()(parser&, const std::string&) const { }
+	};
+}
+
+static_assert(accepted<void (*)()> == void_, "function pointer");
+static_assert(accepted<decltype(no_args)> == void_, "no arguments");
+static_assert(accepted<decltype(parser_only)> == with_parser, "parser only");
+static_assert(accepted<decltype(value_only)> == with_value, "value only");
+static_assert(accepted<decltype(both)> == with_both, "parser and value");
+static_assert(accepted<decltype(returns_int)> == (void_ | returning_int), "result may be dropped or converted");
+static_assert(accepted<decltype(value_copy)> == with_value, "value taken by copy");
+static_assert(accepted<decltype(generic)> == (custom_prototypes | with_int), "generic lambda returning void");
+static_assert(accepted<decltype(value_ref)> == 0, "a const value does not bind to std::string&");
+static_assert(accepted<decltype(int_only)> == with_int, "int only");
+static_assert(accepted<overloaded> == (void_ | with_both), "overloaded call operators");
+static_assert(accepted<decltype(returns_text)> == (with_value | returning_bool), "const char* converts to bool");
+static_assert(accepted<int> == 0, "not callable");
+
+static_assert(custom<void (*)()>, "function pointer");
+static_assert(custom<decltype(generic)>, "generic lambda");
+static_assert(custom<overloaded>, "overloaded call operators");
+static_assert(!custom<decltype(value_ref)>, "a const value does not bind to std::string&");
+static_assert(!custom<decltype(int_only)>, "int only");
+static_assert(!custom<int>, "not callable");
+
+namespace {
+	// counts the live copies of a target
+	struct tracked {
+		int* live;
+		int offset;
+
+		tracked(int* live, int offset) : live { live }, offset { offset } { ++*live; }
+		tracked(tracked&& other) noexcept : live { other.live }, offset { other.offset } { ++*live; }
+		~tracked() { --*live; }
+
+		int operator()(int value) const { return value + offset; }
+	};
+
+	int twice(int value) { return value * 2; }
+}
+
+TEST(inplace_function_is_empty_by_default)
+{
+	stdex::inplace_function<int(int)> empty;
+	stdex::inplace_function<int(int)> null { nullptr };
+	CHECK(!empty);
+	CHECK(!null);
+
+	stdex::inplace_function<int(int)> fn { twice };
+	CHECK(fn);
+	CHECK_EQ(fn(4), 8);
+}
+
+TEST(inplace_function_moves_its_target)
+{
+	int live = 0;
+	{
+		stdex::inplace_function<int(int)> from { tracked { &live, 1 } };
+		CHECK_EQ(live, 1);
+
+		auto to = std::move(from);
+		CHECK(!from);
+		CHECK(to);
+		CHECK_EQ(live, 1);
+		CHECK_EQ(to(1), 2);
+	}
+	CHECK_EQ(live, 0);
+}
+
+TEST(inplace_function_move_assignment_destroys_the_old_target)
+{
+	int first = 0;
+	int second = 0;
+	{
+		stdex::inplace_function<int(int)> fn { tracked { &first, 1 } };
+		stdex::inplace_function<int(int)> other { tracked { &second, 10 } };
+
+		fn = std::move(other);
+		CHECK_EQ(first, 0);
+		CHECK_EQ(second, 1);
+		CHECK(!other);
+		CHECK_EQ(fn(1), 11);
+
+		fn = std::move(fn);
+		CHECK_EQ(second, 1);
+		CHECK_EQ(fn(1), 11);
+
+		fn = nullptr;
+		CHECK(!fn);
+		CHECK_EQ(second, 0);
+	}
+	CHECK_EQ(first, 0);
+	CHECK_EQ(second, 0);
+}
+
+TEST(inplace_function_keeps_move_only_targets)
+{
+	auto value = std::make_unique<int>(5);
+	stdex::inplace_function<int()> fn { [value = std::move(value)] { return *value; } };
+	auto moved = std::move(fn);
+	CHECK_EQ(moved(), 5);
+}
+
+TEST(function_ref_calls_free_functions)
+{
+	stdex::function_ref<int(int)> by_name { twice };
+	stdex::function_ref<int(int)> by_address { &twice };
+	CHECK_EQ(by_name(3), 6);
+	CHECK_EQ(by_address(4), 8);
+
+	int (*pointer)(int) = twice;
+	stdex::function_ref<int(int)> by_pointer { pointer };
+	pointer = nullptr;
+	CHECK_EQ(by_pointer(5), 10);
+}
+
+TEST(function_ref_refers_to_lambdas)
+{
+	int calls = 0;
+	auto count = [&calls](int value) { ++calls; return value + calls; };
+	stdex::function_ref<int(int)> ref { count };
+	CHECK_EQ(ref(10), 11);
+	CHECK_EQ(ref(10), 12);
+	CHECK_EQ(calls, 2);
+
+	int live = 0;
+	const tracked target { &live, 7 };
+	stdex::function_ref<int(int)> to_const { target };
+	CHECK_EQ(to_const(1), 8);
+	CHECK_EQ(live, 1);
+
+	auto copy = ref;
+	CHECK_EQ(copy(0), 3);
+}
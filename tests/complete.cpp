@@ -0,0 +1,119 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "argsparser.h"
+#include "testing.h"
+
+namespace {
+	struct tool {
+		std::string level, jobs, target;
+		bool verbose = false;
+		int built = 0;
+		args::parser parser { "" };
+
+		tool()
+		{
+			parser.provide_completion(true);
+			parser.arg(level, "level").opt().complete([](std::string_view prefix, std::pmr::vector<std::pmr::string>& out) {
+				out.emplace_back(prefix).append("debug");
+			});
+			parser.set<std::true_type>(verbose, "v").opt();
+			parser.command("build", "build things", [this](args::parser& sub) {
+				++built;
+				sub.arg(jobs, "j", "jobs").opt().complete([](std::string_view prefix, std::pmr::vector<std::pmr::string>& out) {
+					out.emplace_back(prefix).append("4");
+				});
+				sub.arg(target, "target").opt();
+			});
+			parser.command("clean", "remove things", [](args::parser&) { });
+		}
+
+		std::pmr::string complete(std::initializer_list<std::string_view> words)
+		{
+			testing::argv argv { words };
+			auto res = parser.try_parse(argv.argc(), argv.data());
+			CHECK_EQ(res.code, args::result::complete);
+			return res.message;
+		}
+	};
+}
+
+TEST(completes_commands_and_options)
+{
+	tool t;
+	CHECK_EQ(t.complete({ "tool", "--complete", "" }), "build\nclean\n");
+	CHECK_EQ(t.complete({ "tool", "--complete", "b" }), "build\n");
+	CHECK_EQ(t.complete({ "tool", "--complete", "--l" }), "--level\n");
+	CHECK_EQ(t.complete({ "tool", "--complete", "x", "--level" }), "xdebug\n");
+	CHECK_EQ(t.built, 0);
+}
+
+TEST(completes_inside_commands)
+{
+	tool t;
+	CHECK_EQ(t.complete({ "tool", "--complete", "--j", "build" }), "--jobs\n");
+	CHECK_EQ(t.complete({ "tool", "--complete", "", "build", "--jobs" }), "4\n");
+	CHECK_EQ(t.complete({ "tool", "--complete", "", "-v", "--level", "build", "build", "-j" }), "4\n");
+	CHECK_EQ(t.complete({ "tool", "--complete", "--t", "build", "-j", "2" }), "--target\n");
+	CHECK_EQ(t.built, 1);
+
+	CHECK_EQ(t.complete({ "tool", "--complete", "", "missing" }), "");
+}
+
+TEST(first_query_scans_like_the_index)
+{
+	const std::initializer_list<std::string_view> queries[] = {
+		{ "tool", "--complete", "" },
+		{ "tool", "--complete", "-" },
+		{ "tool", "--complete", "--" },
+		{ "tool", "--complete", "--l" },
+		{ "tool", "--complete", "-v" },
+		{ "tool", "--complete", "x", "--level" },
+		{ "tool", "--complete", "--j", "-v", "build" },
+	};
+
+	tool indexed;
+	indexed.complete({ "tool", "--complete", "" });
+	indexed.complete({ "tool", "--complete", "" });
+	for (auto& words : queries) {
+		tool scanned;
+		CHECK_EQ(scanned.complete(words), indexed.complete(words));
+	}
+}
+
+TEST(parses_fully_after_completing)
+{
+	std::string mode;
+	args::parser parser { "" };
+	parser.provide_completion(true);
+	auto b = parser.arg(mode, "mode");
+	b.choices({ "fast", "slow" });
+
+	testing::argv tab { { "tool", "--complete", "--m" } };
+	auto res = parser.try_parse(tab.argc(), tab.data());
+	CHECK_EQ(res.code, args::result::complete);
+	CHECK_EQ(res.message, "--mode\n");
+
+	testing::argv bad { { "tool", "--mode", "medium" } };
+	res = parser.try_parse(bad.argc(), bad.data());
+	CHECK_EQ(res.code, args::result::error);
+
+	testing::argv missing { { "tool" } };
+	res = parser.try_parse(missing.argc(), missing.data());
+	CHECK_EQ(res.code, args::result::error);
+
+	testing::argv good { { "tool", "--mode", "slow" } };
+	res = parser.try_parse(good.argc(), good.data());
+	CHECK_EQ(res.code, args::result::ok);
+	CHECK_EQ(mode, "slow");
+}
+
+TEST(zsh_script_skips_empty_output)
+{
+	tool t;
+	auto script = t.complete({ "tool", "--complete-script", "zsh" });
+	std::string_view text { script };
+	auto filter = text.find("candidates=(\"${(@)candidates:#}\")");
+	CHECK(filter != std::string_view::npos);
+	CHECK(filter < text.find("compadd"));
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+
+// Allocation counters shared by the tests and benchmarks. A memory
+// resource counts what goes through it; one source file per program may
+// define TESTING_COUNT_GLOBAL_NEW before including this header to replace
+// operator new and count everything else, too.
+namespace testing {
+	class counting_resource : public std::pmr::memory_resource {
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			++allocations;
+			outstanding += bytes;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+		{
+			outstanding -= bytes;
+			std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	public:
+		size_t allocations = 0;
+		size_t outstanding = 0; // bytes not deallocated yet
+	};
+
+	inline size_t global_allocations = 0;
+	inline size_t global_allocated = 0; // bytes, never decreases
+}
+
+#ifdef TESTING_COUNT_GLOBAL_NEW
+#	if defined(__GNUC__) && !defined(__clang__)
+#		pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#	endif
+
+void* operator new(size_t size)
+{
+	++testing::global_allocations;
+	testing::global_allocated += size;
+	if (auto ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc { };
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+// std::pmr::new_delete_resource() allocates through these
+void* operator new(size_t size, std::align_val_t align)
+{
+	++testing::global_allocations;
+	testing::global_allocated += size;
+	auto alignment = static_cast<size_t>(align);
+	size = (size + alignment - 1) / alignment * alignment;
+#	ifdef _WIN32
+	auto ptr = _aligned_malloc(size ? size : alignment, alignment);
+#	else
+	auto ptr = std::aligned_alloc(alignment, size ? size : alignment);
+#	endif
+	if (ptr)
+		return ptr;
+	throw std::bad_alloc { };
+}
+
+#	ifdef _WIN32
+void operator delete(void* ptr, std::align_val_t) noexcept { _aligned_free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { _aligned_free(ptr); }
+#	else
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+#	endif
+#endif
@@ -0,0 +1,118 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+// Built with ARGS_INSTRUMENT: the counter in front of a parser's memory
+// resource dies with the parser, so nothing that outlives the parser may
+// allocate through it.
+
+#include "argsparser.h"
+#include "counting.h"
+#include "testing.h"
+
+TEST(schema_outlives_its_parser)
+{
+	testing::counting_resource mr;
+	std::string name;
+	{
+		std::shared_ptr<const args::schema> shared;
+		{
+			args::parser p { "", { }, &mr };
+			p.arg(name, "name");
+			p.command("build", "build things", [](args::parser&) { });
+			shared = p.share();
+		}
+		CHECK(shared->resource() == &mr);
+
+		args::parser q { shared, { }, &mr };
+		testing::argv argv { "prog", "--name", "value", "build" };
+		CHECK(q.try_parse(argv.argc(), argv.data()));
+		CHECK_EQ(name, "value");
+	}
+	CHECK_EQ(mr.outstanding, 0u);
+}
+
+TEST(results_outlive_their_parser)
+{
+	testing::counting_resource mr;
+	{
+		auto res = [&] {
+			args::parser p { "", { }, &mr };
+			p.command("build", "build things", [](args::parser&) { });
+			testing::argv argv { "prog", "build", "--bad" };
+			return p.try_parse(argv.argc(), argv.data());
+		}();
+		CHECK(res.message.get_allocator().resource() == &mr);
+		CHECK_EQ(res.message, "unrecognized argument: --bad");
+	}
+	CHECK_EQ(mr.outstanding, 0u);
+}
+
+TEST(counts_the_parsers_own_allocations)
+{
+	size_t allocations = 0;
+	args::parser p { "" };
+	p.instrument([&](const args::stats& stats) { allocations = stats.allocations; });
+	testing::argv argv { "prog", "a", "b" };
+	std::vector<std::string> files;
+	p.arg(files);
+	CHECK(p.try_parse(argv.argc(), argv.data()));
+	CHECK(allocations > 0);
+}
+
+TEST(counts_lookups_comparisons_and_visits)
+{
+	std::string alpha, gamma;
+	bool verbose = false;
+	std::vector<std::string> files;
+	args::parser p { "" };
+	p.arg(alpha, "alpha").opt();
+	p.arg(gamma, "gamma").opt();
+	p.set<std::true_type>(verbose, "v").opt();
+	p.arg(files).opt();
+
+	args::stats stats;
+	p.instrument([&](const args::stats& last) { stats = last; });
+	testing::argv argv { "prog", "--alpha", "1", "-v", "--gamma", "2", "file" };
+	CHECK(p.try_parse(argv.argc(), argv.data()));
+
+	// two long names and one short; each long name takes two steps of a
+	// binary search over { alpha, gamma } and one equality check
+	CHECK_EQ(stats.lookups, 3u);
+	CHECK_EQ(stats.comparisons, 6u);
+	CHECK_EQ(stats.visits, 4u);
+	CHECK(stats.time[args::stats::registration].count() > 0);
+	CHECK(stats.time[args::stats::tokenizing].count() > 0);
+	CHECK(stats.time[args::stats::dispatch].count() > 0);
+	CHECK(stats.time[args::stats::required].count() > 0);
+	CHECK_EQ(stats.time[args::stats::rendering].count(), 0);
+
+	// help stops before any lookup, but renders
+	testing::argv help { "prog", "--help" };
+	CHECK_EQ(p.try_parse(help.argc(), help.data()).code, args::result::help);
+	CHECK_EQ(stats.lookups, 0u);
+	CHECK_EQ(stats.comparisons, 0u);
+	CHECK_EQ(stats.visits, 0u);
+	CHECK(stats.time[args::stats::rendering].count() > 0);
+	CHECK_EQ(stats.time[args::stats::required].count(), 0);
+}
+
+static_assert(!std::is_move_assignable<args::parser>::value, "assigning a parser would destroy the counter its containers allocate from");
+
+TEST(moved_parser_keeps_counting)
+{
+	testing::counting_resource mr;
+	{
+		std::vector<std::string> files;
+		args::parser p { "", { }, &mr };
+		p.arg(files);
+		args::parser moved { std::move(p) };
+
+		size_t allocations = 0;
+		moved.instrument([&](const args::stats& stats) { allocations = stats.allocations; });
+		testing::argv argv { "prog", "a", "b" };
+		CHECK(moved.try_parse(argv.argc(), argv.data()));
+		CHECK(allocations > 0);
+		CHECK_EQ(files.size(), 2u);
+	}
+	CHECK_EQ(mr.outstanding, 0u);
+}
@@ -0,0 +1,14 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "testing.h"
+
+int main()
+{
+	for (auto& test : testing::registry()) {
+		auto before = testing::failures();
+		test.run();
+		std::printf("[%s] %s\n", testing::failures() == before ? " ok " : "FAIL", test.name);
+	}
+	return testing::failures() ? 1 : 0;
+}
@@ -0,0 +1,447 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "argsparser.h"
+#include "testing.h"
+
+namespace {
+	const char* const no_env[] = { nullptr };
+
+	args::result parse(args::parser& p, std::initializer_list<std::string_view> words)
+	{
+		testing::argv argv { words };
+		p.environment(no_env);
+		return p.try_parse(argv.argc(), argv.data());
+	}
+}
+
+TEST(stores_values_and_flags)
+{
+	std::string name;
+	bool verbose = false;
+	std::vector<std::string> files;
+	args::parser p { "" };
+	p.arg(name, "n", "name");
+	p.set<std::true_type>(verbose, "v").opt();
+	p.arg(files).opt();
+
+	auto res = parse(p, { "prog", "--name", "value", "-v", "a", "b" });
+	CHECK_EQ(res.code, args::result::ok);
+	CHECK_EQ(name, "value");
+	CHECK(verbose);
+	CHECK_EQ(files.size(), 2u);
+}
+
+TEST(reports_errors_without_exiting)
+{
+	std::string name;
+	args::parser p { "" };
+	p.arg(name, "name");
+
+	auto res = parse(p, { "prog" });
+	CHECK_EQ(res.code, args::result::error);
+	CHECK_EQ(res.message, "argument --name is required");
+
+	res = parse(p, { "prog", "--name" });
+	CHECK_EQ(res.code, args::result::error);
+	CHECK_EQ(res.message, "argument --name: expected one argument");
+
+	res = parse(p, { "prog", "--other" });
+	CHECK_EQ(res.code, args::result::error);
+	CHECK_EQ(res.message, "unrecognized argument: --other");
+}
+
+TEST(returns_help)
+{
+	args::parser p { "Description." };
+	auto res = parse(p, { "prog", "-h" });
+	CHECK_EQ(res.code, args::result::help);
+	CHECK_EQ(res.message, "usage: prog [-h]\n\nDescription.\n\noptional arguments:\n -h, --help show this help message and exit\n");
+}
+
+TEST(reuses_the_schema_between_parses)
+{
+	std::string name;
+	args::parser p { "" };
+	p.arg(name, "name").opt();
+
+	CHECK(parse(p, { "prog", "--name", "first" }));
+	CHECK_EQ(name, "first");
+	CHECK(p.visited(0));
+
+	CHECK(parse(p, { "prog" }));
+	CHECK(!p.visited(0));
+	CHECK_EQ(name, "first");
+}
+
+TEST(first_registration_of_a_name_wins)
+{
+	std::string first, second;
+	args::parser p { "" };
+	for (auto i = 0; i < 40; ++i)
+		p.arg(second, "option-" + std::to_string(i)).opt();
+	p.arg(first, "name").opt();
+	p.arg(second, "name").opt();
+	p.arg(second, "option-7").opt();
+
+	CHECK(parse(p, { "prog", "--name", "value", "--option-7", "seven" }));
+	CHECK_EQ(first, "value");
+	CHECK_EQ(second, "seven");
+	CHECK(p.visited(7));
+	CHECK(!p.visited(42));
+}
+
+TEST(shared_schema_rebinds_destinations)
+{
+	std::string original, rebound;
+	args::parser p { "" };
+	auto id = p.arg(original, "name").id();
+	auto shared = p.share();
+
+	args::parser other { shared };
+	other.destination(id, rebound);
+	testing::argv argv { "prog", "--name", "value" };
+	CHECK(other.try_parse(argv.argc(), argv.data()));
+	CHECK_EQ(rebound, "value");
+	CHECK_EQ(original, "");
+}
+
+TEST(destination_binds_after_later_registrations)
+{
+	std::string first, second, rebound;
+	args::parser p { "" };
+	auto id = p.arg(first, "first").opt().id();
+	p.destination(id, rebound);
+	p.arg(second, "second").opt();
+
+	CHECK(parse(p, { "prog", "--first", "1", "--second", "2" }));
+	CHECK_EQ(rebound, "1");
+	CHECK_EQ(first, "");
+	CHECK_EQ(second, "2");
+}
+
+TEST(builder_edits_apply_after_first_parse)
+{
+	std::string name, token;
+	args::parser p { "" };
+	auto b = p.arg(name, "name");
+	b.opt();
+	auto t = p.arg(token, "token");
+	t.opt();
+	CHECK(parse(p, { "prog" }));
+
+	b.req();
+	CHECK_EQ(parse(p, { "prog" }).message, "argument --name is required");
+	b.opt();
+	CHECK(parse(p, { "prog" }));
+
+	t.env("APP_TOKEN");
+	const char* const env[] = { "APP_TOKEN=secret", nullptr };
+	testing::argv argv { "prog" };
+	p.environment(env);
+	CHECK(p.try_parse(argv.argc(), argv.data()));
+	CHECK_EQ(token, "secret");
+}
+
+TEST(checks_constraints)
+{
+	bool a = false, b = false, c = false;
+	args::parser p { "" };
+	auto ia = p.set<std::true_type>(a, "a").opt().id();
+	auto ib = p.set<std::true_type>(b, "b").opt().id();
+	auto ic = p.set<std::true_type>(c, "c").opt().id();
+	p.exclusive({ ia, ib });
+	p.depends(ic, { ia });
+
+	CHECK(parse(p, { "prog", "-a" }));
+	CHECK_EQ(parse(p, { "prog", "-a", "-b" }).message, "argument -b: not allowed with argument -a");
+	CHECK_EQ(parse(p, { "prog", "-c" }).message, "argument -c requires argument -a");
+	CHECK(parse(p, { "prog", "-c", "-a" }));
+}
+
+TEST(checks_required_groups_and_conflicts)
+{
+	bool x = false, y = false, z = false;
+	args::parser p { "" };
+	auto ix = p.set<std::true_type>(x, "x").opt().id();
+	auto iy = p.set<std::true_type>(y, "y").opt().id();
+	auto iz = p.set<std::true_type>(z, "z").opt().id();
+	p.at_least_one({ ix, iy });
+	p.conflicts(iz, { iy });
+
+	CHECK(parse(p, { "prog", "-x" }));
+	CHECK(parse(p, { "prog", "-x", "-y" }));
+	CHECK(parse(p, { "prog", "-x", "-z" }));
+	CHECK_EQ(parse(p, { "prog" }).message, "one of the arguments -x -y is required");
+	CHECK_EQ(parse(p, { "prog", "-z" }).message, "one of the arguments -x -y is required");
+	CHECK_EQ(parse(p, { "prog", "-y", "-z" }).message, "argument -z: not allowed with argument -y");
+}
+
+TEST(maps_choices_to_indices)
+{
+	enum color { red, green, blue } value = red;
+	args::parser p { "" };
+	p.arg(value, "color").choices({ "red", "green", "blue" });
+
+	CHECK(parse(p, { "prog", "--color", "blue" }));
+	CHECK_EQ(value, blue);
+
+	auto res = parse(p, { "prog", "--color", "pink" });
+	CHECK_EQ(res.code, args::result::error);
+	CHECK_EQ(res.message, "argument --color: invalid choice: 'pink' (choose from 'red', 'green', 'blue')");
+}
+
+TEST(integral_choices_keep_their_values)
+{
+	int port = 0;
+	std::vector<unsigned> sizes;
+	args::parser p { "" };
+	p.arg(port, "port").choices({ "80", "443" });
+	p.arg(sizes, "s").opt().choices({ "16", "32" });
+
+	CHECK(parse(p, { "prog", "--port", "443", "-s", "32", "-s", "16" }));
+	CHECK_EQ(port, 443);
+	CHECK(sizes == (std::vector<unsigned> { 32, 16 }));
+	CHECK_EQ(parse(p, { "prog", "--port", "1" }).message, "argument --port: invalid choice: '1' (choose from '80', '443')");
+}
+
+TEST(choices_apply_after_first_parse)
+{
+	enum color { red, green, blue } value = red;
+	args::parser p { "" };
+	auto b = p.arg(value, "color");
+	CHECK(parse(p, { "prog", "--color", "1" }));
+	CHECK_EQ(value, green);
+
+	b.choices({ "red", "green", "blue" });
+	CHECK(parse(p, { "prog", "--color", "blue" }));
+	CHECK_EQ(value, blue);
+	CHECK_EQ(parse(p, { "prog", "--color", "1" }).message, "argument --color: invalid choice: '1' (choose from 'red', 'green', 'blue')");
+
+	b.choices({ "green", "red" });
+	CHECK(parse(p, { "prog", "--color", "red" }));
+	CHECK_EQ(value, green);
+}
+
+TEST(reports_invalid_numbers)
+{
+	int count = 7;
+	std::vector<unsigned char> keys;
+	args::parser p { "" };
+	p.arg(count, "count").opt();
+	p.arg(keys, "k").opt();
+
+	CHECK_EQ(parse(p, { "prog", "--count", "abc" }).message, "argument --count: invalid value: 'abc'");
+	CHECK_EQ(parse(p, { "prog", "--count", "12x" }).message, "argument --count: invalid value: '12x'");
+	CHECK_EQ(count, 7);
+
+	CHECK_EQ(parse(p, { "prog", "-k", "1", "-k", "zz" }).message, "argument -k: invalid value: 'zz'");
+	CHECK_EQ(parse(p, { "prog", "-k", "256" }).message, "argument -k: invalid value: '256'");
+	CHECK_EQ(keys.size(), 1u);
+
+	CHECK(parse(p, { "prog", "--count", "-3", "-k", "255" }));
+	CHECK_EQ(count, -3);
+	CHECK_EQ(keys.back(), 255);
+}
+
+TEST(falls_back_to_environment)
+{
+	std::string token;
+	args::parser p { "" };
+	p.arg(token, "token").env("APP_TOKEN");
+
+	const char* const env[] = { "OTHER=1", "APP_TOKEN=secret", nullptr };
+	testing::argv argv { "prog" };
+	p.environment(env);
+	CHECK(p.try_parse(argv.argc(), argv.data()));
+	CHECK_EQ(token, "secret");
+
+	testing::argv given { "prog", "--token", "cli" };
+	CHECK(p.try_parse(given.argc(), given.data()));
+	CHECK_EQ(token, "cli");
+}
+
+TEST(environment_yields_to_excluded_options)
+{
+	bool verbose = false, quiet = false;
+	int count = 0;
+	std::vector<std::string> tags;
+	args::parser p { "" };
+	auto v = p.set<std::true_type>(verbose, "v").opt().env("APP_V").id();
+	auto n = p.arg(count, "n").opt().id();
+	auto q = p.set<std::true_type>(quiet, "q").opt().env("APP_Q").id();
+	p.arg(tags, "t").opt().env("APP_TAGS");
+	p.exclusive({ v, n });
+	p.conflicts(n, { q });
+
+	const char* const env[] = { "APP_V=1", "APP_Q=1", "APP_TAGS=a b", nullptr };
+	p.environment(env);
+	testing::argv given { "prog", "-n", "3" };
+	CHECK(p.try_parse(given.argc(), given.data()));
+	CHECK_EQ(count, 3);
+	CHECK(!verbose);
+	CHECK(!quiet);
+	CHECK(tags == std::vector<std::string> { "a b" });
+
+	testing::argv none { "prog" };
+	CHECK(p.try_parse(none.argc(), none.data()));
+	CHECK(verbose);
+	CHECK(quiet);
+}
+
+TEST(runs_selected_command)
+{
+	std::string out;
+	int built = 0;
+	args::parser p { "" };
+	p.command("build", "build things", [&](args::parser& sub) {
+		++built;
+		sub.arg(out, "o").opt();
+	});
+	p.command("clean", "remove things", [&](args::parser&) { ++built; });
+
+	CHECK(parse(p, { "prog", "build", "-o", "file" }));
+	CHECK_EQ(p.command(), "build");
+	CHECK_EQ(out, "file");
+	CHECK(parse(p, { "prog", "build" }));
+	CHECK_EQ(built, 1);
+
+	CHECK_EQ(parse(p, { "prog" }).message, "argument COMMAND is required");
+}
+
+TEST(adds_commands_between_parses)
+{
+	int cleaned = 0;
+	args::parser p { "" };
+	p.command("build", "build things", [](args::parser&) { });
+	CHECK(parse(p, { "prog", "build" }));
+
+	p.command("clean", "remove things", [&](args::parser&) { ++cleaned; });
+	CHECK(parse(p, { "prog", "clean" }));
+	CHECK_EQ(p.command(), "clean");
+	CHECK_EQ(cleaned, 1);
+	CHECK(parse(p, { "prog", "build" }));
+	CHECK_EQ(p.command(), "build");
+}
+
+TEST(fills_positionals_before_the_command)
+{
+	std::string input;
+	std::vector<std::string> extra;
+	args::parser p { "" };
+	p.arg(input).meta("FILE");
+	p.command("build", "build things", [](args::parser&) { });
+
+	CHECK(parse(p, { "prog", "in.txt", "build" }));
+	CHECK_EQ(input, "in.txt");
+	CHECK_EQ(p.command(), "build");
+	// a required positional takes a word even when it names a command
+	CHECK(parse(p, { "prog", "build", "build" }));
+	CHECK_EQ(input, "build");
+	CHECK_EQ(parse(p, { "prog", "in.txt" }).message, "argument COMMAND is required");
+	CHECK_EQ(parse(p, { "prog", "in.txt", "other" }).message, "unrecognized argument: other");
+
+	args::parser q { "" };
+	q.arg(extra).meta("FILE").opt();
+	q.command("build", "build things", [](args::parser&) { });
+	CHECK(parse(q, { "prog", "a", "b", "build" }));
+	CHECK(extra == (std::vector<std::string> { "a", "b" }));
+	CHECK(parse(q, { "prog", "build" }));
+	CHECK_EQ(q.command(), "build");
+}
+
+TEST(builds_each_command_once)
+{
+	int builds = 0, cleans = 0;
+	std::string out;
+	args::parser p { "" };
+	p.command("build", "build things", [&](args::parser& sub) {
+		++builds;
+		sub.arg(out, "o").opt();
+	});
+	p.command("clean", "remove things", [&](args::parser&) { ++cleans; });
+
+	for (int round = 0; round < 100; ++round) {
+		CHECK(parse(p, { "prog", "build", "-o", "file" }));
+		CHECK(parse(p, { "prog", "clean" }));
+	}
+	CHECK_EQ(builds, 1);
+	CHECK_EQ(cleans, 1);
+
+	// parsers of a shared schema reuse what the first parser built
+	auto shared = p.share();
+	std::string other;
+	args::parser q { shared };
+	CHECK(parse(q, { "prog", "clean" }));
+	CHECK(parse(q, { "prog", "build", "-o", "x" }));
+	CHECK(q.command_parser()->destination(0, other));
+	CHECK(parse(q, { "prog", "build", "-o", "y" }));
+	CHECK_EQ(builds, 1);
+	CHECK_EQ(cleans, 1);
+	CHECK_EQ(out, "x");
+	CHECK_EQ(other, "y");
+}
+
+TEST(calls_custom_actions)
+{
+	int flags = 0;
+	std::string seen;
+	args::parser p { "" };
+	p.custom([&] { ++flags; }, "f").opt();
+	p.custom([&](args::parser&, const std::string& value) { seen = value; }, "s").opt();
+
+	CHECK(parse(p, { "prog", "-f", "-s", "text", "-f" }));
+	CHECK_EQ(flags, 2);
+	CHECK_EQ(seen, "text");
+}
+
+TEST(custom_actions_take_any_movable_callable)
+{
+	int calls = 0;
+	std::string seen;
+	std::string prefix = "a prefix long enough to live on the heap, ";
+	std::string suffix = ", and a suffix just as long as the prefix";
+
+	// boxed, as the callback's own move must not throw
+	struct throwing_move {
+		int* calls;
+		throwing_move(int* calls) : calls { calls } {}
+		throwing_move(throwing_move&& other) noexcept(false) : calls { other.calls } {}
+		void operator()() const { ++*calls; }
+	};
+	static_assert(!std::is_nothrow_move_constructible<throwing_move>::value);
+	int thrown = 0;
+
+	args::parser p { "" };
+	p.custom([count = std::make_unique<int>(0), &calls] { calls = ++*count; }, "u").opt();
+	p.custom([prefix, suffix, &seen](const std::string& value) { seen = prefix + value + suffix; }, "s").opt();
+	p.custom(throwing_move { &thrown }, "t").opt();
+
+	CHECK(parse(p, { "prog", "-u", "-u", "-s", "x", "-t" }));
+	CHECK_EQ(calls, 2);
+	CHECK_EQ(seen, prefix + "x" + suffix);
+	CHECK_EQ(thrown, 1);
+}
+
+TEST(copies_text_unless_static)
+{
+	std::string value;
+	std::string name = "name";
+	std::string help = "help given as a view";
+	const char meta[] = { 'M', 'E', 'T', 'A', 0 };
+	static char borrowed[] = "borrowed help";
+
+	args::parser p { "" };
+	p.arg(value, std::string_view { name }).opt().help(std::string_view { help }).meta(meta);
+	p.arg(value, args::static_text { "other" }).opt().help(args::static_text { borrowed });
+	name.assign("gone");
+	help.assign("overwritten text of another length");
+	borrowed[0] = 'B';
+
+	auto& text = p.help_text();
+	CHECK(text.find("--name META") != std::string::npos);
+	CHECK(text.find("help given as a view") != std::string::npos);
+	CHECK(text.find("Borrowed help") != std::string::npos);
+	CHECK(parse(p, { "prog", "--name", "x" }));
+	CHECK_EQ(value, "x");
+}
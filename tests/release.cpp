@@ -0,0 +1,116 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+// Built with NDEBUG: API misuse the debug build asserts on must still be
+// rejected without undefined behaviour.
+
+#include "argsparser.h"
+#include "testing.h"
+
+TEST(destination_rejects_other_types_and_ids)
+{
+	std::string value;
+	long other = 0;
+	args::parser p { "" };
+	auto id = p.arg(value, "name").id();
+	auto custom = p.custom([] {}, "flag").opt().id();
+	auto shared = p.share();
+
+	args::parser q { shared };
+	CHECK(!q.destination(id, other));
+	CHECK(!q.destination(id + 10, value));
+	CHECK(!q.destination(custom, value));
+
+	testing::argv argv { "prog", "--name", "text" };
+	CHECK(q.try_parse(argv.argc(), argv.data()));
+	CHECK_EQ(value, "text");
+	CHECK_EQ(other, 0);
+}
+
+TEST(shared_schema_ignores_builder_edits)
+{
+	std::string name;
+	args::parser p { "" };
+	auto b = p.arg(name, "name");
+	b.opt();
+	auto shared = p.share();
+
+	b.req().help("changed").choices({ "a", "b" });
+	CHECK(!shared->action(b.id()).required());
+	CHECK_EQ(shared->action(b.id()).help(), "");
+	CHECK(shared->action(b.id()).choices().empty());
+
+	args::parser q { shared };
+	testing::argv argv { "prog", "--name", "c" };
+	CHECK(q.try_parse(argv.argc(), argv.data()));
+	CHECK_EQ(name, "c");
+}
+
+TEST(choices_after_first_parse_are_compiled)
+{
+	enum level { low, high } value = low;
+	args::parser p { "" };
+	auto b = p.arg(value, "level");
+	testing::argv first { "prog", "--level", "0" };
+	CHECK(p.try_parse(first.argc(), first.data()));
+
+	b.choices({ "low", "high" });
+	testing::argv second { "prog", "--level", "high" };
+	CHECK(p.try_parse(second.argc(), second.data()));
+	CHECK_EQ(value, high);
+}
+
+TEST(shared_parsers_ignore_registration)
+{
+	std::string name, other;
+	bool flag = false;
+	args::parser p { "" };
+	p.arg(name, "name").opt();
+	auto shared = p.share();
+	args::parser q { shared };
+
+	for (auto parser : { &p, &q }) {
+		auto b = parser->arg(other, "other");
+		CHECK_EQ(b.id(), args::schema::npos);
+		b.req().help("ignored").meta("X").env("OTHER").choices({ "a" });
+		CHECK_EQ(parser->set<std::true_type>(flag, "f").opt().id(), args::schema::npos);
+		CHECK_EQ(parser->custom([] { }, "c").id(), args::schema::npos);
+		parser->command("build", "", [](args::parser&) { });
+		parser->usage("ignored");
+		parser->provide_help(false);
+		parser->provide_completion(true);
+		parser->exclusive({ 0 });
+		parser->at_least_one({ 0 });
+		parser->depends(0, { 0 });
+		parser->conflicts(0, { 0 });
+	}
+
+	CHECK_EQ(shared->size(), 1u);
+	CHECK(shared->usage().empty());
+	CHECK(shared->provide_help());
+	testing::argv argv { "prog", "--name", "value" };
+	CHECK(q.try_parse(argv.argc(), argv.data()));
+	CHECK_EQ(name, "value");
+	testing::argv other_argv { "prog", "--other", "value" };
+	CHECK_EQ(q.try_parse(other_argv.argc(), other_argv.data()).message, "unrecognized argument: --other");
+}
+
+TEST(constraints_with_unknown_ids_are_dropped)
+{
+	bool a = false, b = false;
+	args::parser p { "" };
+	auto ia = p.set<std::true_type>(a, "a").opt().id();
+	auto ib = p.set<std::true_type>(b, "b").opt().id();
+	p.exclusive({ ia, 500 });
+	p.at_least_one({ 700, ib });
+	p.depends(ia, { 900 });
+	p.conflicts(args::schema::npos, { ib });
+	p.exclusive({ ia, ib });
+
+	testing::argv both { "prog", "-a", "-b" };
+	CHECK_EQ(p.try_parse(both.argc(), both.data()).message, "argument -b: not allowed with argument -a");
+	testing::argv one { "prog", "-a" };
+	CHECK(p.try_parse(one.argc(), one.data()));
+	testing::argv none { "prog" };
+	CHECK(p.try_parse(none.argc(), none.data()));
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "argsparser.h"
+#include "counting.h"
+#include "testing.h"
+
+namespace {
+	bool contains(std::string_view text, std::string_view part)
+	{
+		return text.find(part) != std::string_view::npos;
+	}
+}
+
+TEST(help_follows_builder_edits)
+{
+	std::string name;
+	args::parser p { "" };
+	auto b = p.arg(name, "name");
+	b.opt().help("first help");
+	CHECK(contains(p.help_text(), "first help"));
+
+	b.help("second help").meta("VALUE");
+	CHECK(contains(p.help_text(), "second help"));
+	CHECK(contains(p.help_text(), "[--name VALUE]"));
+	CHECK(!contains(p.help_text(), "first help"));
+}
+
+TEST(help_is_rendered_once_per_catalog)
+{
+	testing::counting_resource mr;
+	args::parser p { "Description.", { }, &mr };
+	p.help_text(80);
+	auto rendered = mr.allocations;
+	p.help_text(80);
+	CHECK_EQ(mr.allocations, rendered);
+
+	p.messages().invalidate();
+	p.help_text(80);
+	CHECK(mr.allocations > rendered);
+}
+
+TEST(help_keeps_only_the_last_width)
+{
+	testing::counting_resource mr;
+	args::parser p { "A description long enough to wrap differently on narrow and wide terminals.", { }, &mr };
+	std::string narrow { p.help_text(40) };
+	CHECK(narrow != std::string_view { p.help_text(80) });
+	CHECK_EQ(p.help_text(40), narrow);
+
+	for (size_t width = 100; width < 1100; ++width)
+		p.help_text(width);
+	auto outstanding = mr.outstanding;
+	for (size_t width = 1100; width < 2100; ++width)
+		p.help_text(width);
+	CHECK_EQ(mr.outstanding, outstanding);
+}
+
+TEST(help_follows_message_locale)
+{
+	if constexpr (args::translator::localized) {
+		testing::counting_resource mr;
+		args::parser p { "Description.", { }, &mr };
+		std::setlocale(LC_MESSAGES, "C");
+		p.help_text(80);
+		auto rendered = mr.allocations;
+
+		if (!std::setlocale(LC_MESSAGES, "C.UTF-8"))
+			return;
+		p.help_text(80);
+		CHECK(mr.allocations > rendered);
+		std::setlocale(LC_MESSAGES, "C");
+	}
+}
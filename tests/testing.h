@@ -0,0 +1,96 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Just enough of a test framework for include-only headers: TEST
+// registers a function, CHECK and CHECK_EQ report and count failures,
+// and main runs everything, returning non-zero when anything failed.
+namespace testing {
+	struct test {
+		const char* name;
+		void (*run)();
+	};
+
+	inline std::vector<test>& registry()
+	{
+		static std::vector<test> tests;
+		return tests;
+	}
+
+	inline size_t& failures()
+	{
+		static size_t count = 0;
+		return count;
+	}
+
+	struct registrar {
+		registrar(const char* name, void (*run)()) { registry().push_back({ name, run }); }
+	};
+
+	inline void fail(const char* file, int line, const char* expr)
+	{
+		std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+		++failures();
+	}
+
+	inline std::string printable(std::string_view s)
+	{
+		return "\"" + std::string { s } + "\"";
+	}
+
+	template <typename T>
+	inline auto printable(const T& value) -> decltype(std::to_string(value))
+	{
+		return std::to_string(value);
+	}
+
+	template <typename L, typename R>
+	inline void check_eq(const char* file, int line, const char* expr, const L& lhs, const R& rhs)
+	{
+		if constexpr (std::is_convertible<const L&, std::string_view>::value && std::is_convertible<const R&, std::string_view>::value) {
+			// strings with different allocators compare by content
+			if (std::string_view { lhs } == std::string_view { rhs })
+				return;
+		} else if (lhs == rhs)
+			return;
+		fail(file, line, expr);
+		std::fprintf(stderr, "    lhs: %s\n    rhs: %s\n", printable(lhs).c_str(), printable(rhs).c_str());
+	}
+
+	// Modifiable, NUL-terminated argv built from a list of words
+	class argv {
+		std::vector<std::string> words_;
+		std::vector<char*> ptrs_;
+	public:
+		argv(std::initializer_list<std::string_view> words)
+		{
+			words_.reserve(words.size());
+			for (auto word : words)
+				words_.emplace_back(word);
+			for (auto& word : words_)
+				ptrs_.push_back(word.data());
+			ptrs_.push_back(nullptr);
+		}
+
+		int argc() const { return static_cast<int>(words_.size()); }
+		char** data() { return ptrs_.data(); }
+	};
+}
+
+#define TEST(NAME) \
+	static void NAME(); \
+	static ::testing::registrar NAME##_registrar { #NAME, NAME }; \
+	static void NAME()
+
+#define CHECK(EXPR) \
+	do { if (!(EXPR)) ::testing::fail(__FILE__, __LINE__, #EXPR); } while (0)
+
+#define CHECK_EQ(LHS, RHS) \
+	::testing::check_eq(__FILE__, __LINE__, #LHS " == " #RHS, (LHS), (RHS))
@@ -0,0 +1,79 @@
+// Copyright (c) 2016 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "argsparser.h"
+#include "testing.h"
+#include <fstream>
+#include <sstream>
+
+namespace {
+	std::string golden(size_t width)
+	{
+		std::ifstream in { std::string { GOLDEN_DIR } + "/help_" + std::to_string(width) + ".txt", std::ios::binary };
+		std::ostringstream out;
+		out << in.rdbuf();
+		return out.str();
+	}
+}
+
+// The golden files are the help output of the byte-counting wrapper that
+// preceded the UTF-8 engine, captured from a terminal of each width.
+TEST(ascii_help_matches_golden_output)
+{
+	std::string a;
+	bool v = false;
+	std::vector<std::string> pos;
+	args::parser p { "A test program with a long description to wrap around. It goes on and on and on, with many words, so that wrapping is really exercised by narrow terminals." };
+	p.arg(a, "a", "alpha").meta("VAL").help("alpha value which is described with quite a few words to wrap nicely");
+	p.set<std::true_type>(v, "v", "verbose").help("be verbose").opt();
+	p.arg(pos).meta("FILE").multi().opt().help("input files to process, each one separately");
+	p.arg(a, "very-long-option-name-indeed").opt().help("something long");
+	p.program("wb");
+
+	for (size_t width : { 10, 15, 20, 30, 40, 50, 60, 80 }) {
+		auto expected = golden(width);
+		CHECK(!expected.empty());
+		CHECK_EQ(p.help_text(width), expected);
+	}
+}
+
+TEST(wide_characters_take_two_columns)
+{
+	args::parser p { "\xE6\xBC\xA2\xE5\xAD\x97\xE6\xBC\xA2\xE5\xAD\x97 \xE6\xBC\xA2\xE5\xAD\x97\xE6\xBC\xA2\xE5\xAD\x97 abcdefg" };
+	p.provide_help(false);
+	p.program("prog");
+
+	// 8 + 1 + 8 columns do not fit in 16, 8 + 1 + 7 do
+	CHECK_EQ(p.help_text(17), "usage: prog\n\n"
+		"\xE6\xBC\xA2\xE5\xAD\x97\xE6\xBC\xA2\xE5\xAD\x97\n"
+		"\xE6\xBC\xA2\xE5\xAD\x97\xE6\xBC\xA2\xE5\xAD\x97 abcdefg\n");
+}
+
+TEST(combining_marks_take_no_columns)
+{
+	// each e + U+0301 is three bytes, but one column
+	args::parser p { "e\xCC\x81" "e\xCC\x81" "e\xCC\x81" "e\xCC\x81" "e\xCC\x81 abcdefghij xyz" };
+	p.provide_help(false);
+	p.program("prog");
+
+	CHECK_EQ(p.help_text(17), "usage: prog\n\n"
+		"e\xCC\x81" "e\xCC\x81" "e\xCC\x81" "e\xCC\x81" "e\xCC\x81 abcdefghij\n"
+		"xyz\n");
+}
+
+TEST(splits_through_mutable_iterators)
+{
+	// "abc " fits in 5 columns, "abc de" does not
+	std::string text = "abc de fgh";
+	auto it = args::detail::split(text.begin(), text.end(), 5);
+	CHECK_EQ(size_t(it - text.begin()), 3u);
+	CHECK(args::detail::skip_ws(it, text.end()) == text.begin() + 4);
+
+	std::vector<char> chars { text.begin(), text.end() };
+	auto cit = args::detail::split(chars.cbegin(), chars.cend(), 5);
+	CHECK_EQ(size_t(cit - chars.cbegin()), 3u);
+
+	char* data = text.data();
+	CHECK(args::detail::split(data, data + text.length(), 5) == data + 3);
+	CHECK(args::detail::split(data, data + text.length(), 80) == data + text.length());
+}